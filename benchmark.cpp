@@ -0,0 +1,466 @@
+#include "benchmark.h"
+
+#include <bit>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <format>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+#include "dxg.h"
+#include "dxg_index.h"
+#include "mrb.h"
+#include "mrb_index.h"
+#include "kernels.h"
+#include "skeleton.h"
+#include "scene_ir.h"
+#include "mapped_file.h"
+#include "fixtures.h"
+#include "log.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// every case repeats until both are reached and reports its fastest run
+	constexpr int MIN_RUNS = 3;
+	constexpr auto MIN_DURATION = std::chrono::milliseconds(100);
+	// the last step is around 2 GB of DXG, one more would overflow its 32 bit sizes
+	constexpr unsigned MAX_STEPS = 7;
+
+	// what the cases return is folded into this, so the measured work can't be optimized away
+	volatile uint64_t sink = 0;
+
+	struct Result
+	{
+		std::string_view name;
+		std::string_view unit;
+		double ns_per_element;
+	};
+
+	// body runs the case once and returns something that depends on all of its work
+	template<class Body>
+	Result Measure(std::string_view name, std::string_view unit, uint64_t elements, Body&& body)
+	{
+		auto best = Clock::duration::max();
+		auto total = Clock::duration::zero();
+		for (int run = 0; run < MIN_RUNS || total < MIN_DURATION; run++)
+		{
+			auto start = Clock::now();
+			sink = sink + body();
+			auto duration = Clock::now() - start;
+			best = std::min(best, duration);
+			total += duration;
+		}
+		return { name, unit, elements ? std::chrono::duration<double, std::nano>(best).count() / elements : 0. };
+	}
+
+	uint64_t Fold(const void* pointer)
+	{
+		return reinterpret_cast<uintptr_t>(pointer);
+	}
+
+	uint64_t Fold(float value)
+	{
+		return std::bit_cast<uint32_t>(value);
+	}
+
+	fixtures::Parameters GetStepParameters(uint32_t scale)
+	{
+		fixtures::Parameters parameters;
+		parameters.groups = 8 * scale;
+		parameters.blocks = 2;
+		parameters.meshes = std::min(4 * scale, 127u);
+		parameters.vertices = 200;
+		parameters.faces = 300;
+		parameters.bones = 64;
+		parameters.weight_bones = 4;
+		parameters.clips = 8 * scale;
+		parameters.keyframes = 30 * scale;
+		return parameters;
+	}
+
+	struct MeshEntry
+	{
+		const dxg::MeshHeader* header;
+		dxg::MeshGroupDataView data;
+	};
+
+	// generated files with every header the cases walk collected up front
+	struct Fixture
+	{
+		explicit Fixture(const std::filesystem::path& folder)
+			: dxg_file(folder / "fixture.dxg")
+			, mrb_file(folder / "fixture.mrb")
+		{
+			dxg_header = reinterpret_cast<const dxg::FileHeader*>(dxg_file.data());
+			list_header = dxg_header->GetMeshGroupListHeader();
+			skeleton = Skeleton(dxg_header->GetSkeletonHeader());
+			mesh_group_index = dxg::MeshGroupIndex(list_header);
+			mrb_header = reinterpret_cast<const mrb::FileHeader*>(mrb_file.data());
+
+			for (int group_idx = 0; group_idx < static_cast<int>(mesh_group_index.GetGroupCount()); group_idx++)
+			{
+				group_headers.push_back(mesh_group_index.GetMeshGroupHeader(group_idx));
+				for (auto&& group_data_entry : mesh_group_index.GetGroupData(group_idx))
+				{
+					group_data_headers.push_back(mesh_group_index.GetMeshGroupDataHeader(group_data_entry));
+					auto data = mesh_group_index.GetMeshGroupDataView(group_data_entry);
+					for (int mesh_idx = 0; mesh_idx < static_cast<int>(group_data_entry.mesh_count); mesh_idx++)
+					{
+						auto mesh_header = mesh_group_index.GetMeshHeader(group_data_entry, mesh_idx);
+						meshes.push_back({ mesh_header, data });
+						vertex_count += mesh_header->vertex_count;
+						face_count += mesh_header->face_count;
+						if (mesh_header->weight_bone_count && mesh_header->weight_bone_indices_count)
+						{
+							weighted_vertex_count += mesh_header->vertex_count;
+						}
+					}
+				}
+			}
+
+			mrb::AnimationIndex animation_index(mrb_header);
+			for (int animation_idx = 0; animation_idx < static_cast<int>(animation_index.GetAnimationCount()); animation_idx++)
+			{
+				animation_headers.push_back(animation_index.GetAnimation(animation_idx).GetHeader());
+			}
+
+			logging::Buffer log;
+			ir::BuildAnimationClips(mrb_file.GetData(), skeleton, {}, clips, log);
+			log.Flush();
+			for (auto&& clip : clips)
+			{
+				for (auto&& track : clip.tracks)
+				{
+					key_count += track.rotations.size();
+					max_track_keys = std::max(max_track_keys, track.rotations.size());
+				}
+			}
+		}
+
+		MappedFile dxg_file;
+		MappedFile mrb_file;
+		const dxg::FileHeader* dxg_header;
+		const dxg::MeshGroupListHeader* list_header;
+		const mrb::FileHeader* mrb_header;
+		Skeleton skeleton;
+		dxg::MeshGroupIndex mesh_group_index;
+
+		std::vector<const dxg::MeshGroupHeader*> group_headers;
+		std::vector<const dxg::MeshGroupDataHeader*> group_data_headers;
+		std::vector<MeshEntry> meshes;
+		std::vector<const mrb::AnimationHeader*> animation_headers;
+		std::vector<ir::AnimationClip> clips;
+
+		uint64_t vertex_count = 0;
+		uint64_t face_count = 0;
+		uint64_t weighted_vertex_count = 0;
+		// bone keys of every clip
+		uint64_t key_count = 0;
+		size_t max_track_keys = 0;
+	};
+
+	void MeasureDxgAccessors(const Fixture& fixture, std::vector<Result>& results)
+	{
+		auto skeleton_names = fixture.dxg_header->GetSkeletonHeader()->GetBoneNames();
+		auto name_count = fixture.list_header->group_count + fixture.skeleton.GetBoneCount();
+		for (auto&& mesh : fixture.meshes)
+		{
+			name_count += mesh.header->weight_bone_count;
+		}
+		results.push_back(Measure("StringList::Parse", "name", name_count, [&]
+		{
+			uint64_t result = fixture.list_header->GetGroupNames()->Parse().size() + skeleton_names->Parse().size();
+			for (auto&& mesh : fixture.meshes)
+			{
+				result += mesh.header->GetWeightedBoneNames()->Parse().size();
+			}
+			return result;
+		}));
+
+		results.push_back(Measure("GetMeshGroupHeader(i)", "group", fixture.list_header->group_count, [&]
+		{
+			uint64_t result = 0;
+			for (int group_idx = 0; group_idx < static_cast<int>(fixture.list_header->group_count); group_idx++)
+			{
+				result += Fold(fixture.list_header->GetMeshGroupHeader(group_idx));
+			}
+			return result;
+		}));
+
+		results.push_back(Measure("GetMeshGroupDataHeader(i)", "block", fixture.group_data_headers.size(), [&]
+		{
+			uint64_t result = 0;
+			for (auto group_header : fixture.group_headers)
+			{
+				for (int group_data_idx = 0; group_data_idx < static_cast<int>(group_header->group_data_count); group_data_idx++)
+				{
+					result += Fold(group_header->GetMeshGroupDataHeader(group_data_idx));
+				}
+			}
+			return result;
+		}));
+
+		results.push_back(Measure("GetMeshHeader(i)", "mesh", fixture.meshes.size(), [&]
+		{
+			uint64_t result = 0;
+			for (auto group_data_header : fixture.group_data_headers)
+			{
+				for (int mesh_idx = 0; mesh_idx < group_data_header->mesh_count; mesh_idx++)
+				{
+					result += Fold(group_data_header->GetMeshHeader(mesh_idx));
+				}
+			}
+			return result;
+		}));
+
+		// every stream resolved on its own, each call re-walks the ones before it
+		results.push_back(Measure("Attribute span chain", "block", fixture.group_data_headers.size(), [&]
+		{
+			uint64_t result = 0;
+			for (auto group_data_header : fixture.group_data_headers)
+			{
+				result += Fold(group_data_header->GetPositions().data()) + Fold(group_data_header->GetNormals().data()) +
+					Fold(group_data_header->GetUVs().data()) + Fold(group_data_header->GetUVs2().data()) +
+					Fold(group_data_header->GetColors().data()) + Fold(group_data_header->GetWeights().data());
+			}
+			return result;
+		}));
+
+		results.push_back(Measure("MeshGroupDataHeader::GetView", "block", fixture.group_data_headers.size(), [&]
+		{
+			uint64_t result = 0;
+			for (auto group_data_header : fixture.group_data_headers)
+			{
+				result += Fold(group_data_header->GetView().weights.data());
+			}
+			return result;
+		}));
+
+		results.push_back(Measure("dxg::MeshGroupIndex", "mesh", fixture.meshes.size(), [&]
+		{
+			dxg::MeshGroupIndex index(fixture.list_header);
+			return static_cast<uint64_t>(index.GetGroupCount());
+		}));
+	}
+
+	void MeasureMrbAccessors(const Fixture& fixture, std::vector<Result>& results)
+	{
+		results.push_back(Measure("GetAnimationHeader(i)", "clip", fixture.mrb_header->animation_count, [&]
+		{
+			uint64_t result = 0;
+			for (int animation_idx = 0; animation_idx < static_cast<int>(fixture.mrb_header->animation_count); animation_idx++)
+			{
+				result += Fold(fixture.mrb_header->GetAnimationHeader(animation_idx));
+			}
+			return result;
+		}));
+
+		// every block of every clip, the generated clips have all of them
+		uint64_t lookup_count = 0;
+		for (auto animation_header : fixture.animation_headers)
+		{
+			lookup_count += std::popcount(static_cast<uint32_t>(animation_header->data_bitfield));
+		}
+		results.push_back(Measure("GetDataBlock", "lookup", lookup_count, [&]
+		{
+			uint64_t result = 0;
+			for (auto animation_header : fixture.animation_headers)
+			{
+				for (auto types = static_cast<uint32_t>(animation_header->data_bitfield); types; types &= types - 1)
+				{
+					auto type = static_cast<mrb::EAnimationDataType>(1u << std::countr_zero(types));
+					result += Fold(animation_header->GetDataBlock(type));
+				}
+			}
+			return result;
+		}));
+
+		results.push_back(Measure("mrb::AnimationIndex", "clip", fixture.mrb_header->animation_count, [&]
+		{
+			mrb::AnimationIndex index(fixture.mrb_header);
+			return static_cast<uint64_t>(index.GetAnimationCount());
+		}));
+	}
+
+	// the loops of ir::BuildMeshGroups one by one, over every mesh of the file
+	void MeasureMeshLoops(const Fixture& fixture, std::vector<Result>& results)
+	{
+		size_t max_vertices = 0;
+		size_t max_faces = 0;
+		for (auto&& mesh : fixture.meshes)
+		{
+			max_vertices = std::max<size_t>(max_vertices, mesh.header->vertex_count);
+			max_faces = std::max<size_t>(max_faces, mesh.header->face_count);
+		}
+
+		std::vector<Vector3> positions(max_vertices);
+		std::vector<Vector3> normals(max_vertices);
+		std::vector<Vector2> uvs(max_vertices);
+		results.push_back(Measure("Vertex attribute gather", "vertex", fixture.vertex_count, [&]
+		{
+			for (auto&& mesh : fixture.meshes)
+			{
+				auto vertices = mesh.header->GetVertexDataIndices();
+				kernels::GatherVertexAttribute(positions.data(), mesh.data.positions, vertices, &dxg::VertexDataIndices::position_index);
+				kernels::GatherVertexAttribute(normals.data(), mesh.data.normals, vertices, &dxg::VertexDataIndices::normal_index);
+				kernels::GatherVertexAttribute(uvs.data(), mesh.data.uvs, vertices, &dxg::VertexDataIndices::uv_index);
+			}
+			return Fold(positions[0].x) + Fold(normals[0].x) + Fold(uvs[0].x);
+		}));
+
+		std::vector<uint32_t> indices(max_faces * 3);
+		results.push_back(Measure("Face index rebase", "face", fixture.face_count, [&]
+		{
+			uint64_t result = 0;
+			for (auto&& mesh : fixture.meshes)
+			{
+				auto faces = mesh.header->GetFaces();
+				kernels::RebaseIndices(std::span<const uint16_t>(reinterpret_cast<const uint16_t*>(faces.data()), faces.size() * 3), 0, indices.data());
+				result += indices[0];
+			}
+			return result;
+		}));
+
+		// weighted bones resolved to skeleton bones beforehand, like BuildGroupData does per mesh
+		std::vector<int> bones(8);
+		std::iota(bones.begin(), bones.end(), 0);
+		std::vector<dxg::BoneWeights> vertex_bone_weights(max_vertices);
+		std::vector<float> weights(max_vertices * 3);
+		std::vector<uint16_t> joints(max_vertices * 3);
+		results.push_back(Measure("Bone weight expand", "vertex", fixture.weighted_vertex_count, [&]
+		{
+			for (auto&& mesh : fixture.meshes)
+			{
+				if (!mesh.header->weight_bone_count || !mesh.header->weight_bone_indices_count)
+				{
+					continue;
+				}
+				auto vertices = mesh.header->GetVertexDataIndices();
+				kernels::GatherVertexAttribute(vertex_bone_weights.data(), mesh.data.weights, vertices, &dxg::VertexDataIndices::position_index);
+				kernels::ExpandBoneWeights(reinterpret_cast<const float*>(vertex_bone_weights.data()), vertices.size(), weights.data());
+				kernels::ResolveJoints(weights.data(), reinterpret_cast<const int8_t*>(mesh.header->GetWeightBoneIndices().data()),
+					std::span<const int>(bones).first(mesh.header->weight_bone_count), vertices.size(), joints.data());
+			}
+			return Fold(weights[0]) + joints[0];
+		}));
+
+		results.push_back(Measure("ir::BuildMeshGroups, -t 1", "vertex", fixture.vertex_count, [&]
+		{
+			return static_cast<uint64_t>(ir::BuildMeshGroups(fixture.dxg_header, fixture.skeleton, 1).size());
+		}));
+
+		results.push_back(Measure("ir::BuildMeshGroups, -t 0", "vertex", fixture.vertex_count, [&]
+		{
+			return static_cast<uint64_t>(ir::BuildMeshGroups(fixture.dxg_header, fixture.skeleton, 0).size());
+		}));
+	}
+
+	// the per key work of ir::BuildAnimationClips, kernels on the tracks it built
+	void MeasureKeyLoops(Fixture& fixture, std::vector<Result>& results)
+	{
+		std::vector<Vector3> euler_rotations(fixture.max_track_keys);
+		results.push_back(Measure("Quaternions to euler", "key", fixture.key_count, [&]
+		{
+			for (auto&& clip : fixture.clips)
+			{
+				for (auto&& track : clip.tracks)
+				{
+					kernels::QuaternionsToEuler(reinterpret_cast<const float*>(track.rotations.data()), track.rotations.size(), reinterpret_cast<float*>(euler_rotations.data()));
+				}
+			}
+			return Fold(euler_rotations[0].x);
+		}));
+
+		// both are idempotent, later runs see the same data as the first
+		results.push_back(Measure("Hemisphere align and unroll", "key", fixture.key_count, [&]
+		{
+			for (auto&& clip : fixture.clips)
+			{
+				for (auto&& track : clip.tracks)
+				{
+					kernels::AlignQuaternionHemispheres(reinterpret_cast<float*>(track.rotations.data()), track.rotations.size());
+					kernels::UnrollEulerAngles(reinterpret_cast<float*>(track.euler_rotations.data()), track.euler_rotations.size());
+				}
+			}
+			return Fold(fixture.clips[0].tracks[0].rotations[0].x);
+		}));
+
+		results.push_back(Measure("ir::BuildAnimationClips", "key", fixture.key_count, [&]
+		{
+			std::vector<ir::AnimationClip> clips;
+			logging::Buffer log;
+			ir::BuildAnimationClips(fixture.mrb_file.GetData(), fixture.skeleton, {}, clips, log);
+			return static_cast<uint64_t>(clips.size());
+		}));
+	}
+}
+
+namespace benchmark
+{
+	void Run(const std::filesystem::path& folder, unsigned step_count)
+	{
+		if (!step_count || step_count > MAX_STEPS)
+		{
+			throw std::invalid_argument(std::format("Expected 1 to {} benchmark steps, got {}\n", MAX_STEPS, step_count));
+		}
+
+		// conversion code logs per file at info level, only the report should show up
+		auto level = logging::GetLevel();
+		logging::SetLevel(std::min(level, logging::ELevel::Warning));
+
+		std::filesystem::create_directories(folder);
+
+		std::vector<std::vector<Result>> steps;
+		std::string sizes;
+		for (unsigned step = 0; step < step_count; step++)
+		{
+			auto scale = 1u << step;
+			auto parameters = GetStepParameters(scale);
+			fixtures::WriteDxg(folder / "fixture.dxg", parameters);
+			fixtures::WriteMrb(folder / "fixture.mrb", parameters);
+
+			// closed before the next step writes over the files
+			Fixture fixture(folder);
+			auto line = std::format("  x{}: dxg {:.1f} MB, {} groups, {} meshes per block, {} vertices, {} faces; mrb {:.1f} MB, {} clips of {} keys\n",
+				scale, fixture.dxg_file.size() / (1024.0 * 1024.0), parameters.groups, parameters.meshes, fixture.vertex_count,
+				fixture.face_count, fixture.mrb_file.size() / (1024.0 * 1024.0), parameters.clips, parameters.keyframes);
+			sizes += line;
+			if (level >= logging::ELevel::Info)
+			{
+				logging::Write(std::format("Benchmark step {}/{}\n{}", step + 1, step_count, line));
+			}
+
+			auto& results = steps.emplace_back();
+			MeasureDxgAccessors(fixture, results);
+			MeasureMrbAccessors(fixture, results);
+			MeasureMeshLoops(fixture, results);
+			MeasureKeyLoops(fixture, results);
+		}
+
+		logging::SetLevel(level);
+
+		// one row per case, one column per step
+		std::string report = std::format("{:<30}{:<8}", "ns per element", "per");
+		for (unsigned step = 0; step < step_count; step++)
+		{
+			report += std::format("{:>10}", std::format("x{}", 1u << step));
+		}
+		report += '\n';
+		for (size_t case_idx = 0; case_idx < steps[0].size(); case_idx++)
+		{
+			report += std::format("{:<30}{:<8}", steps[0][case_idx].name, steps[0][case_idx].unit);
+			for (auto&& results : steps)
+			{
+				report += std::format("{:>10.2f}", results[case_idx].ns_per_element);
+			}
+			report += '\n';
+		}
+		report += "Inputs\n" + sizes;
+		logging::Write(std::move(report));
+	}
+}
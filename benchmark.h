@@ -0,0 +1,13 @@
+#pragma once
+#include <filesystem>
+
+// Microbenchmarks of the dxg.h/mrb.h accessors and the per element conversion loops, each in isolation,
+// on generated fixtures of growing size. Results are ns per element for every size, a case whose ns/element
+// grows along with the input walks something quadratically.
+namespace benchmark
+{
+	// Fixtures of step_count sizes, each step doubles the groups, meshes per block, clips and keyframes
+	// of the previous one. They are written to folder as fixture.dxg and fixture.mrb, the last step stays there.
+	// The report goes to stdout whatever the log level, throws like fixtures::WriteDxg/WriteMrb.
+	void Run(const std::filesystem::path& folder, unsigned step_count);
+}
@@ -0,0 +1,30 @@
+#include "deflate.h"
+
+#include <limits>
+#include <format>
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace zlib
+{
+	std::vector<uint8_t> Compress(std::span<const uint8_t> data)
+	{
+		// uLong is 32 bit on Windows
+		if (data.size() > std::numeric_limits<uLong>::max())
+		{
+			throw std::invalid_argument(std::format("Can't deflate {} bytes in one zlib call\n", data.size()));
+		}
+
+		auto source_size = static_cast<uLong>(data.size());
+		std::vector<uint8_t> result(compressBound(source_size));
+		auto result_size = static_cast<uLongf>(result.size());
+		auto status = compress2(result.data(), &result_size, data.data(), source_size, Z_BEST_SPEED);
+		if (status != Z_OK)
+		{
+			throw std::logic_error(std::format("zlib compress2 failed with {}\n", status));
+		}
+		result.resize(result_size);
+		return result;
+	}
+}
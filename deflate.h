@@ -0,0 +1,13 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstdint>
+
+// zlib stream (RFC 1950) compression for the native FBX writer, through the zlib the FBX SDK builds link anyway
+namespace zlib
+{
+	// compress2 at Z_BEST_SPEED, FBX arrays are mostly floats that higher levels barely shrink further.
+	// Throws std::invalid_argument for inputs zlib can't take in one call (4 GB where uLong is 32 bit)
+	// and std::logic_error if zlib fails.
+	std::vector<uint8_t> Compress(std::span<const uint8_t> data);
+}
@@ -2,6 +2,7 @@
 #include <span>
 #include <vector>
 #include <string_view>
+#include <cstring>
 
 #include "magic_enum.h"
 #include "common.h"
@@ -165,6 +166,18 @@ namespace dxg
 		}
 	};
 
+	// all attribute streams of a MeshGroupDataHeader resolved at once,
+	// so per-vertex code doesn't re-walk the mesh headers for every access
+	struct MeshGroupDataView
+	{
+		std::span<const Vector3> positions;
+		std::span<const Vector3> normals;
+		std::span<const Vector2> uvs;
+		std::span<const Vector2> uvs_2;
+		std::span<const ColorRGBA> colors;
+		std::span<const BoneWeights> weights;
+	};
+
 	struct MeshGroupDataHeader
 	{
 		uint32_t unk0;
@@ -251,6 +264,24 @@ namespace dxg
 				weights_count / 2
 			};
 		}
+
+		// meshes_end is the first byte after the last mesh, e.g. GetMeshHeader(mesh_count)
+		MeshGroupDataView GetView(const void* meshes_end) const
+		{
+			MeshGroupDataView view;
+			view.positions = { reinterpret_cast<const Vector3*>(meshes_end), position_count };
+			view.normals = { reinterpret_cast<const Vector3*>(view.positions.data() + view.positions.size()), normal_count };
+			view.uvs = { reinterpret_cast<const Vector2*>(view.normals.data() + view.normals.size()), uv_1_count };
+			view.uvs_2 = { reinterpret_cast<const Vector2*>(view.uvs.data() + view.uvs.size()), uv_2_count };
+			view.colors = { reinterpret_cast<const ColorRGBA*>(view.uvs_2.data() + view.uvs_2.size()), color_count };
+			view.weights = { reinterpret_cast<const BoneWeights*>(view.colors.data() + view.colors.size()), weights_count / 2 };
+			return view;
+		}
+
+		MeshGroupDataView GetView() const
+		{
+			return GetView(GetMeshHeader(mesh_count));
+		}
 	};
 
 	struct MeshGroupHeader
@@ -0,0 +1,131 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "dxg.h"
+
+namespace dxg
+{
+	// Flat directory of every header inside a MeshGroupListHeader, built with a single walk.
+	// Offsets are relative to the list header, so lookups are O(1) instead of re-walking the chain.
+	class MeshGroupIndex
+	{
+	public:
+		struct GroupEntry
+		{
+			size_t offset;
+			uint32_t first_group_data;
+			uint32_t group_data_count;
+			size_t control_point_count;
+			size_t face_count;
+		};
+
+		struct GroupDataEntry
+		{
+			size_t offset;
+			uint32_t first_mesh;
+			uint32_t mesh_count;
+			size_t control_point_count;
+			size_t face_count;
+			// first byte after the last MeshHeader, where the attribute streams begin
+			size_t meshes_end_offset;
+		};
+
+		MeshGroupIndex() = default;
+
+		explicit MeshGroupIndex(const MeshGroupListHeader* list_header)
+			: _base(reinterpret_cast<const uint8_t*>(list_header))
+		{
+			auto names_data = list_header->GetGroupNames();
+			auto offset = sizeof(MeshGroupListHeader) + sizeof(StringList) + names_data->data_size;
+
+			_groups.reserve(list_header->group_count);
+			for (uint32_t group_idx = 0; group_idx < list_header->group_count; group_idx++)
+			{
+				auto group_header = reinterpret_cast<const MeshGroupHeader*>(_base + offset);
+
+				GroupEntry group_entry{ offset, static_cast<uint32_t>(_group_data.size()), group_header->group_data_count, 0, 0 };
+
+				auto group_data_offset = offset + sizeof(MeshGroupHeader);
+				for (uint32_t group_data_idx = 0; group_data_idx < group_header->group_data_count; group_data_idx++)
+				{
+					auto group_data_header = reinterpret_cast<const MeshGroupDataHeader*>(_base + group_data_offset);
+					auto mesh_count = group_data_header->mesh_count > 0 ? static_cast<uint32_t>(group_data_header->mesh_count) : 0;
+
+					GroupDataEntry group_data_entry{ group_data_offset, static_cast<uint32_t>(_meshes.size()), mesh_count, 0, 0, 0 };
+
+					auto mesh_offset = group_data_offset + sizeof(MeshGroupDataHeader);
+					for (uint32_t mesh_idx = 0; mesh_idx < mesh_count; mesh_idx++)
+					{
+						auto mesh_header = reinterpret_cast<const MeshHeader*>(_base + mesh_offset);
+						_meshes.push_back(mesh_offset);
+						group_data_entry.control_point_count += mesh_header->vertex_count;
+						group_data_entry.face_count += mesh_header->face_count;
+						mesh_offset += sizeof(MeshHeader) + mesh_header->data_size;
+					}
+					group_data_entry.meshes_end_offset = mesh_offset;
+					group_entry.control_point_count += group_data_entry.control_point_count;
+					group_entry.face_count += group_data_entry.face_count;
+
+					_group_data.push_back(group_data_entry);
+					group_data_offset += sizeof(MeshGroupDataHeader) + group_data_header->data_size;
+				}
+
+				_groups.push_back(group_entry);
+				offset += sizeof(MeshGroupHeader) + group_header->data_size;
+			}
+		}
+
+		size_t GetGroupCount() const
+		{
+			return _groups.size();
+		}
+
+		const GroupEntry& GetGroup(int group_idx) const
+		{
+			return _groups[group_idx];
+		}
+
+		std::span<const GroupDataEntry> GetGroupData(int group_idx) const
+		{
+			const auto& group = _groups[group_idx];
+			return { _group_data.data() + group.first_group_data, group.group_data_count };
+		}
+
+		const MeshGroupHeader* GetMeshGroupHeader(int group_idx) const
+		{
+			return reinterpret_cast<const MeshGroupHeader*>(_base + _groups[group_idx].offset);
+		}
+
+		const MeshGroupDataHeader* GetMeshGroupDataHeader(int group_idx, int group_data_idx) const
+		{
+			return GetMeshGroupDataHeader(GetGroupData(group_idx)[group_data_idx]);
+		}
+
+		const MeshGroupDataHeader* GetMeshGroupDataHeader(const GroupDataEntry& group_data) const
+		{
+			return reinterpret_cast<const MeshGroupDataHeader*>(_base + group_data.offset);
+		}
+
+		MeshGroupDataView GetMeshGroupDataView(const GroupDataEntry& group_data) const
+		{
+			return GetMeshGroupDataHeader(group_data)->GetView(_base + group_data.meshes_end_offset);
+		}
+
+		const MeshHeader* GetMeshHeader(const GroupDataEntry& group_data, int mesh_idx) const
+		{
+			return reinterpret_cast<const MeshHeader*>(_base + _meshes[group_data.first_mesh + mesh_idx]);
+		}
+
+		const MeshHeader* GetMeshHeader(int group_idx, int group_data_idx, int mesh_idx) const
+		{
+			return GetMeshHeader(GetGroupData(group_idx)[group_data_idx], mesh_idx);
+		}
+
+	private:
+		const uint8_t* _base = nullptr;
+		std::vector<GroupEntry> _groups;
+		std::vector<GroupDataEntry> _group_data;
+		std::vector<size_t> _meshes;
+	};
+}
@@ -0,0 +1,470 @@
+#include "fbx_sdk_writer.h"
+
+#include <string>
+#include <vector>
+#include <format>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fbxsdk.h>
+
+#include "memory.h"
+#include "trace.h"
+
+namespace
+{
+	fbxsdk::FbxAMatrix ToFbxMatrix(const Matrix4x4& matrix)
+	{
+		fbxsdk::FbxAMatrix fbx_matrix;
+		fbx_matrix.SetRow(0, FbxVector4(matrix.raw[0], matrix.raw[1], matrix.raw[2], matrix.raw[3]));
+		fbx_matrix.SetRow(1, FbxVector4(matrix.raw[4], matrix.raw[5], matrix.raw[6], matrix.raw[7]));
+		fbx_matrix.SetRow(2, FbxVector4(matrix.raw[8], matrix.raw[9], matrix.raw[10], matrix.raw[11]));
+		fbx_matrix.SetRow(3, FbxVector4(matrix.raw[12], matrix.raw[13], matrix.raw[14], matrix.raw[15]));
+		return fbx_matrix;
+	}
+
+	fbxsdk::FbxColor ToFbxColor(const ColorRGBA& color)
+	{
+		return fbxsdk::FbxColor(
+			static_cast<double>(color.R) / 255.0,
+			static_cast<double>(color.G) / 255.0,
+			static_cast<double>(color.B) / 255.0,
+			static_cast<double>(color.A) / 255.0
+		);
+	}
+
+	// Skeleton bone (topological index) -> node of one scene, so bones are resolved without recursive FindChild calls
+	class SkeletonNodeTable
+	{
+	public:
+		void Add(fbxsdk::FbxNode* node)
+		{
+			_nodes.push_back(node);
+		}
+
+		// every skeleton bone has a node once CreateSkeletonScene returns
+		fbxsdk::FbxNode* GetNode(int bone) const
+		{
+			return _nodes[bone];
+		}
+
+	private:
+		std::vector<fbxsdk::FbxNode*> _nodes;
+	};
+
+	// Scene with a Root node holding the skeleton in bind pose, bone nodes are added to skeleton_nodes in topological order
+	fbxsdk::FbxScene* CreateSkeletonScene(fbxsdk::FbxManager* fbx_manager, const char* scene_name, const Skeleton& skeleton, SkeletonNodeTable& skeleton_nodes,
+		fbxsdk::FbxNode*& root_node)
+	{
+		auto scene = fbxsdk::FbxScene::Create(fbx_manager, scene_name);
+		// not sure about this
+		fbxsdk::FbxAxisSystem initial_axis_system;
+		fbxsdk::FbxAxisSystem::ParseAxisSystem("XyZ", initial_axis_system);
+		scene->GetGlobalSettings().SetAxisSystem(initial_axis_system);
+
+		root_node = fbxsdk::FbxNode::Create(fbx_manager, "Root");
+		scene->GetRootNode()->AddChild(root_node);
+
+		// topological order, every parent node exists before its children
+		auto bone_count = static_cast<int>(skeleton.GetBoneCount());
+		for (int bone = 0; bone < bone_count; bone++)
+		{
+			const auto& name = skeleton.names[bone];
+			auto parent = skeleton.parents[bone];
+			auto bone_node = fbxsdk::FbxNode::Create(fbx_manager, std::string(name).c_str());
+			skeleton_nodes.Add(bone_node);
+
+			auto skeleton_attribute = fbxsdk::FbxSkeleton::Create(fbx_manager, "");
+			if (parent == -1)
+			{
+				skeleton_attribute->SetSkeletonType(fbxsdk::FbxSkeleton::EType::eRoot);
+				root_node->AddChild(bone_node);
+			}
+			else
+			{
+				skeleton_attribute->SetSkeletonType(fbxsdk::FbxSkeleton::EType::eLimbNode);
+				skeleton_nodes.GetNode(parent)->AddChild(bone_node);
+			}
+
+			const auto& translation = skeleton.local_translations[bone];
+			const auto& rotation = skeleton.local_rotations[bone];
+			const auto& scale = skeleton.local_scales[bone];
+
+			/*std::cout << std::format("Translation x {} y {} z {}\n", translation.x, translation.y, translation.z);
+			std::cout << std::format("Rotation x {} y {} z {}\n", rotation.x, rotation.y, rotation.z);
+			std::cout << std::format("Scale x {} y {} z {}\n", scale.x, scale.y, scale.z);*/
+
+			bone_node->LclTranslation.Set(fbxsdk::FbxDouble3(translation.x, translation.y, translation.z));
+			bone_node->LclRotation.Set(fbxsdk::FbxDouble3(rotation.x, rotation.y, rotation.z));
+			bone_node->LclScaling.Set(fbxsdk::FbxDouble3(scale.x, scale.y, scale.z));
+
+			bone_node->SetNodeAttribute(skeleton_attribute);
+		}
+
+		return scene;
+	}
+
+	// Writes linear keys into animation curves in bulk. Key times are converted once per clip,
+	// every curve gets its key buffer sized once and is filled by index from one contiguous channel.
+	class CurveBuilder
+	{
+	public:
+		explicit CurveBuilder(std::span<const uint32_t> key_times)
+			: _clip_times(key_times.size())
+		{
+			for (size_t i = 0; i < key_times.size(); i++)
+			{
+				_clip_times[i].SetMilliSeconds(key_times[i]);
+			}
+		}
+
+		// X/Y/Z curves of the property from one value per key, keys are the clip key indices of a reduced channel
+		// and empty if it has every key
+		void Fill(fbxsdk::FbxPropertyT<fbxsdk::FbxDouble3>& property, fbxsdk::FbxAnimLayer* anim_layer, std::span<const Vector3> values,
+			std::span<const uint32_t> keys)
+		{
+			constexpr const char* components[3] = { FBXSDK_CURVENODE_COMPONENT_X, FBXSDK_CURVENODE_COMPONENT_Y, FBXSDK_CURVENODE_COMPONENT_Z };
+
+			std::span<const fbxsdk::FbxTime> times = _clip_times;
+			if (!keys.empty())
+			{
+				_channel_times.resize(keys.size());
+				for (size_t i = 0; i < keys.size(); i++)
+				{
+					_channel_times[i] = _clip_times[keys[i]];
+				}
+				times = _channel_times;
+			}
+
+			_channel.resize(values.size());
+			for (int component = 0; component < 3; component++)
+			{
+				for (size_t i = 0; i < values.size(); i++)
+				{
+					_channel[i] = values[i].raw[component];
+				}
+
+				auto curve = property.GetCurve(anim_layer, components[component], true);
+				curve->KeyModifyBegin();
+				Fill(curve, times);
+				curve->KeyModifyEnd();
+			}
+		}
+
+	private:
+		void Fill(fbxsdk::FbxAnimCurve* curve, std::span<const fbxsdk::FbxTime> times)
+		{
+			auto key_count = static_cast<int>(times.size());
+			curve->ResizeKeyBuffer(key_count);
+			if (curve->KeyGetCount() == key_count)
+			{
+				for (int key_idx = 0; key_idx < key_count; key_idx++)
+				{
+					curve->KeySet(key_idx, times[key_idx], _channel[key_idx], fbxsdk::FbxAnimCurveDef::eInterpolationLinear);
+				}
+			}
+			else
+			{
+				// the buffer was only reserved, times are increasing so every KeyAdd appends
+				for (int key_idx = 0; key_idx < key_count; key_idx++)
+				{
+					curve->KeySet(curve->KeyAdd(times[key_idx]), times[key_idx], _channel[key_idx], fbxsdk::FbxAnimCurveDef::eInterpolationLinear);
+				}
+			}
+		}
+
+		std::vector<fbxsdk::FbxTime> _clip_times;
+		std::vector<fbxsdk::FbxTime> _channel_times;
+		std::vector<float> _channel;
+	};
+
+	// IR clip -> anim stack of the scene, rotations come already converted to continuous FBX euler angles
+	void LowerAnimationClip(const ir::AnimationClip& clip, fbxsdk::FbxScene* scene, const Skeleton& skeleton, const SkeletonNodeTable& skeleton_nodes,
+		logging::Buffer& log)
+	{
+		trace::Scope scope("LowerAnimationClip", clip.name);
+		auto anim_stack = fbxsdk::FbxAnimStack::Create(scene, clip.name.c_str());
+		auto anim_layer = fbxsdk::FbxAnimLayer::Create(anim_stack->GetFbxManager(), std::format("{}_Layer", clip.name).c_str());
+		anim_stack->AddMember(anim_layer);
+
+		CurveBuilder curve_builder(clip.key_times);
+		for (auto&& track : clip.tracks)
+		{
+			auto bone_name = skeleton.names[track.bone];
+			auto bone = skeleton_nodes.GetNode(track.bone);
+			LOG_TO(log, logging::ELevel::Verbose, "Animating bone '{}'\n", bone_name);
+
+			curve_builder.Fill(bone->LclTranslation, anim_layer, track.translations, track.translation_keys);
+			curve_builder.Fill(bone->LclRotation, anim_layer, track.euler_rotations, track.rotation_keys);
+			curve_builder.Fill(bone->LclScaling, anim_layer, track.scales, track.scale_keys);
+
+			LOG_TO(log, logging::ELevel::Verbose, "Added {} keyframses\n", std::max({ track.translations.size(), track.euler_rotations.size(), track.scales.size() }));
+		}
+	}
+
+	// Sizes a direct array once and returns it locked for writing, release with Release(&pointer)
+	template<class T>
+	T* LockDirectArray(fbxsdk::FbxLayerElementTemplate<T>* element, int count)
+	{
+		auto& direct_array = element->GetDirectArray();
+		direct_array.Resize(count);
+		return direct_array.GetLocked(fbxsdk::FbxLayerElementArray::eWriteLock);
+	}
+
+	// Influences collected for one cluster, handed over to the SDK in one bulk call
+	struct ClusterWeights
+	{
+		fbxsdk::FbxCluster* cluster;
+		std::vector<int> control_points;
+		std::vector<double> weights;
+
+		void Apply() const
+		{
+			cluster->SetControlPointIWCount(static_cast<int>(control_points.size()));
+			std::copy(control_points.begin(), control_points.end(), cluster->GetControlPointIndices());
+			std::copy(weights.begin(), weights.end(), cluster->GetControlPointWeights());
+		}
+	};
+
+	// IR mesh group -> group node with a skinned mesh, one control point per IR vertex
+	void LowerMeshGroup(const ir::MeshGroup& group, fbxsdk::FbxManager* fbx_manager, fbxsdk::FbxNode* root_node,
+		const Skeleton& skeleton, const SkeletonNodeTable& skeleton_nodes)
+	{
+		trace::Scope scope("LowerMeshGroup", group.name);
+		auto group_node = fbxsdk::FbxNode::Create(fbx_manager, group.name.data());
+		root_node->AddChild(group_node);
+
+		if (!group.has_geometry)
+		{
+			return;
+		}
+
+		auto mesh_node = group_node;
+		auto mesh_attribute = fbxsdk::FbxMesh::Create(fbx_manager, "");
+		auto skin_deformer = fbxsdk::FbxSkin::Create(fbx_manager, "");
+		mesh_attribute->AddDeformer(skin_deformer);
+		mesh_node->SetNodeAttribute(mesh_attribute);
+
+		auto geometry_element_normal = mesh_attribute->CreateElementNormal();
+		geometry_element_normal->SetMappingMode(FbxGeometryElement::eByControlPoint);
+		geometry_element_normal->SetReferenceMode(FbxGeometryElement::eDirect);
+		auto geometry_element_uv_1 = mesh_attribute->CreateElementUV("uv1");
+		geometry_element_uv_1->SetMappingMode(FbxGeometryElement::eByControlPoint);
+		geometry_element_uv_1->SetReferenceMode(FbxGeometryElement::eDirect);
+		auto geometry_element_uv_2 = mesh_attribute->CreateElementUV("uv2");
+		geometry_element_uv_2->SetMappingMode(FbxGeometryElement::eByControlPoint);
+		geometry_element_uv_2->SetReferenceMode(FbxGeometryElement::eDirect);
+
+		// weird hack to get rid of double vertex color layer
+		auto redudant_element = mesh_attribute->CreateElementVertexColor();
+		if (mesh_attribute->GetElementVertexColorCount() > 1)
+		{
+			mesh_attribute->RemoveElementVertexColor(redudant_element);
+		}
+
+		auto geometry_element_color = mesh_attribute->GetElementVertexColor();
+		geometry_element_color->SetMappingMode(FbxGeometryElement::eByControlPoint);
+		geometry_element_color->SetReferenceMode(FbxGeometryElement::eDirect);
+
+		auto control_point_count = static_cast<int>(group.GetVertexCount());
+		mesh_attribute->InitControlPoints(control_point_count);
+
+		// every element array is sized once up front and filled through a locked pointer
+		auto control_points = mesh_attribute->GetControlPoints();
+		auto normals = LockDirectArray(geometry_element_normal, control_point_count);
+		auto uvs_1 = LockDirectArray(geometry_element_uv_1, control_point_count);
+		auto uvs_2 = group.has_uvs_2 ? LockDirectArray(geometry_element_uv_2, control_point_count) : nullptr;
+		auto colors = group.has_colors ? LockDirectArray(geometry_element_color, control_point_count) : nullptr;
+
+		for (int i = 0; i < control_point_count; i++)
+		{
+			const auto& position = group.positions[i];
+			const auto& normal = group.normals[i];
+			control_points[i] = fbxsdk::FbxVector4(position.x, position.y, position.z);
+			normals[i] = fbxsdk::FbxVector4(normal.x, normal.y, normal.z);
+			uvs_1[i] = fbxsdk::FbxVector2(group.uvs[i].x, 1.0 - group.uvs[i].y);
+		}
+		if (uvs_2)
+		{
+			for (int i = 0; i < control_point_count; i++)
+			{
+				uvs_2[i] = fbxsdk::FbxVector2(group.uvs_2[i].x, 1.0 - group.uvs_2[i].y);
+			}
+		}
+		if (colors)
+		{
+			for (int i = 0; i < control_point_count; i++)
+			{
+				colors[i] = ToFbxColor(group.colors[i]);
+			}
+		}
+
+		// one cluster per influencing bone, in the order the IR first saw them
+		std::vector<int> bone_clusters(skeleton.GetBoneCount(), -1);
+		std::vector<ClusterWeights> cluster_weights;
+		cluster_weights.reserve(group.skin_bones.size());
+		for (auto bone : group.skin_bones)
+		{
+			auto bone_node = skeleton_nodes.GetNode(bone);
+			auto cluster = fbxsdk::FbxCluster::Create(fbx_manager, bone_node->GetName());
+			cluster->SetLink(bone_node);
+			cluster->SetLinkMode(fbxsdk::FbxCluster::eTotalOne);
+			// bind pose from the batch solve instead of evaluating the node hierarchy
+			cluster->SetTransformLinkMatrix(ToFbxMatrix(skeleton.global_bind_matrices[bone]));
+			skin_deformer->AddCluster(cluster);
+			bone_clusters[bone] = static_cast<int>(cluster_weights.size());
+			cluster_weights.push_back({ cluster });
+		}
+
+		for (int i = 0; i < control_point_count; i++)
+		{
+			for (int j = 2; j >= 0; j--)
+			{
+				auto weight = group.weights[i * 3 + j];
+				if (weight == 0.f)
+				{
+					continue;
+				}
+
+				auto& cluster = cluster_weights[bone_clusters[group.joints[i * 3 + j]]];
+				cluster.control_points.push_back(i);
+				cluster.weights.push_back(weight);
+			}
+		}
+
+		for (auto&& cluster : cluster_weights)
+		{
+			cluster.Apply();
+		}
+
+		auto polygon_count = static_cast<int>(group.indices.size() / 3);
+		mesh_attribute->ReservePolygonCount(polygon_count);
+		mesh_attribute->ReservePolygonVertexCount(polygon_count * 3);
+		for (int i = 0; i < polygon_count; i++)
+		{
+			mesh_attribute->BeginPolygon(-1, -1, -1, false);
+			mesh_attribute->AddPolygon(static_cast<int>(group.indices[i * 3 + 0]));
+			mesh_attribute->AddPolygon(static_cast<int>(group.indices[i * 3 + 1]));
+			mesh_attribute->AddPolygon(static_cast<int>(group.indices[i * 3 + 2]));
+			mesh_attribute->EndPolygon();
+		}
+
+		geometry_element_normal->GetDirectArray().Release(&normals);
+		geometry_element_uv_1->GetDirectArray().Release(&uvs_1);
+		if (uvs_2)
+		{
+			geometry_element_uv_2->GetDirectArray().Release(&uvs_2);
+		}
+		if (colors)
+		{
+			geometry_element_color->GetDirectArray().Release(&colors);
+		}
+	}
+
+	void Export(const std::filesystem::path& path, fbxsdk::FbxScene* scene, logging::Buffer& log)
+	{
+		timings::Phase phase("Export", path.string());
+		auto fbx_manager = scene->GetFbxManager();
+		auto exporter = fbxsdk::FbxExporter::Create(fbx_manager, "");
+		LOG_TO(log, logging::ELevel::Info, "Exporting '{}'\n", path.string());
+		exporter->Initialize(path.string().c_str(), -1, fbx_manager->GetIOSettings());
+
+		/*auto rotation = scene->GetRootNode()->LclRotation.Get();
+		rotation.Buffer()[0] += 180.0;
+		scene->GetRootNode()->LclRotation.Set(rotation);*/
+		if (!exporter->Export(scene))
+		{
+			throw std::logic_error(std::format("Failed to export scene\n"));
+		}
+		exporter->Destroy();
+
+		std::error_code error;
+		auto size = std::filesystem::file_size(path, error);
+		phase.counts.bytes = error ? 0 : size;
+	}
+}
+
+namespace fbx_sdk
+{
+	void WriteFbx(const std::filesystem::path& path, std::string_view scene_name, const Skeleton& skeleton,
+		std::span<const ir::MeshGroup> mesh_groups, std::span<const ir::AnimationClip> clips, const timings::Counts& work, logging::Buffer& log)
+	{
+		// a manager per file, so files can be written concurrently
+		auto fbx_manager = fbxsdk::FbxManager::Create();
+		fbx_manager->SetIOSettings(fbxsdk::FbxIOSettings::Create(fbx_manager, IOSROOT));
+
+		auto file_name = path.filename().string();
+		fbxsdk::FbxScene* scene = nullptr;
+		{
+			timings::Phase phase("LowerScene", file_name);
+			phase.counts = work;
+
+			SkeletonNodeTable skeleton_nodes;
+			fbxsdk::FbxNode* root_node = nullptr;
+			scene = CreateSkeletonScene(fbx_manager, std::string(scene_name).c_str(), skeleton, skeleton_nodes, root_node);
+
+			for (auto&& clip : clips)
+			{
+				LowerAnimationClip(clip, scene, skeleton, skeleton_nodes, log);
+			}
+
+			for (auto&& group : mesh_groups)
+			{
+				LowerMeshGroup(group, fbx_manager, root_node, skeleton, skeleton_nodes);
+			}
+		}
+
+		fbxsdk::FbxAxisSystem axis_system;
+		fbxsdk::FbxAxisSystem::ParseAxisSystem("Xyz", axis_system);
+
+		{
+			timings::Phase phase("DeepConvertScene", file_name);
+			axis_system.DeepConvertScene(scene);
+		}
+		Export(path, scene, log);
+
+		// idk what is actual coordinate system so bruteforce all possible
+		// coordinate system and import them to blender to select and use one that looks good lol
+		//char axis_symbols[3][2] = { {'x', 'X'}, {'y', 'Y'},{'z', 'Z'} };
+		//fbxsdk::FbxAxisSystem axis_system;
+		//const char* variants[6][3] = {
+		//	{ axis_symbols[0], axis_symbols[1], axis_symbols[2] },
+		//	{ axis_symbols[0], axis_symbols[2], axis_symbols[1] },
+		//	{ axis_symbols[1], axis_symbols[0], axis_symbols[2] },
+		//	{ axis_symbols[1], axis_symbols[2], axis_symbols[0] },
+		//	{ axis_symbols[2], axis_symbols[1], axis_symbols[0] },
+		//	{ axis_symbols[2], axis_symbols[0], axis_symbols[1] }
+		//};
+		//char axis[4] = {};
+		//for (int i = 0; i < 6; i++)
+		//{
+		//	auto variant = variants[i];
+		//	for (int j = 0; j < 8; j++)
+		//	{
+		//		axis[0] = variant[0][(j & 1) != 0];
+		//		axis[1] = variant[1][(j & 2) != 0];
+		//		axis[2] = variant[2][(j & 4) != 0];
+		//		fbxsdk::FbxAxisSystem::ParseAxisSystem(axis, axis_system);
+
+		//		//root_node->LclTranslation.Set(FbxDouble3(0, 0, 0));
+
+		//		axis_system.DeepConvertScene(_scene);
+
+		//		//root_node->LclTranslation.Set(FbxDouble3(i* j * 500, 0, 0));
+		//		root_node->SetName(axis);
+
+		//		Export(std::format("{}\\output_{}_{}_{}.fbx", output_folder, axis, i, j), _scene);
+		//	}
+		//}
+
+		fbx_manager->Destroy();
+	}
+
+	void UseCountingAllocator()
+	{
+		fbxsdk::FbxSetMallocHandler(memory::Allocate);
+		fbxsdk::FbxSetCallocHandler(memory::AllocateZeroed);
+		fbxsdk::FbxSetReallocHandler(memory::Reallocate);
+		fbxsdk::FbxSetFreeHandler(memory::Free);
+	}
+}
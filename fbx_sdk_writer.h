@@ -0,0 +1,21 @@
+#pragma once
+#include <span>
+#include <string_view>
+#include <filesystem>
+
+#include "scene_ir.h"
+#include "timings.h"
+#include "log.h"
+
+// FBX output through the Autodesk FBX SDK, only built with DXG_WITH_FBX_SDK.
+// The IR is lowered into an SDK scene in the DXG axes and converted to the SDK's Y up system before export.
+namespace fbx_sdk
+{
+	// Skeleton, mesh groups and clips as one .fbx file. work is what the LowerScene phase reports,
+	// export messages go to log. Throws std::logic_error if the SDK fails to export the scene.
+	void WriteFbx(const std::filesystem::path& path, std::string_view scene_name, const Skeleton& skeleton,
+		std::span<const ir::MeshGroup> mesh_groups, std::span<const ir::AnimationClip> clips, const timings::Counts& work, logging::Buffer& log);
+
+	// Routes the SDK's allocations through the counting memory:: functions, call before any SDK object exists
+	void UseCountingAllocator();
+}
@@ -0,0 +1,856 @@
+#include "fbx_writer.h"
+
+#include <map>
+#include <deque>
+#include <limits>
+#include <format>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "deflate.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace
+{
+	constexpr char HEADER_MAGIC[] = "Kaydara FBX Binary  \x00\x1a\x00";
+	// FileId/CreationTime are checked against each other by the SDK, these are a known good pair
+	constexpr uint8_t FILE_ID[16] = { 0x28, 0xb3, 0x2a, 0xeb, 0xb6, 0x24, 0xcc, 0xc2, 0xbf, 0xc8, 0xb0, 0x2a, 0xa9, 0x2b, 0xfc, 0xf1 };
+	constexpr char CREATION_TIME[] = "1970-01-01 10:00:00:000";
+	constexpr uint8_t FOOTER_ID[16] = { 0xfa, 0xbc, 0xab, 0x09, 0xd0, 0xc8, 0xd4, 0x66, 0xb1, 0x76, 0xfb, 0x83, 0x1c, 0xf7, 0x26, 0x7e };
+	constexpr uint8_t FOOTER_MAGIC[16] = { 0xf8, 0x5a, 0x8c, 0x6a, 0xde, 0xf5, 0xd9, 0x7e, 0xec, 0xe9, 0x0c, 0xe3, 0x75, 0x8f, 0x29, 0x0b };
+	constexpr char CREATOR[] = "DXGPareser";
+
+	constexpr int64_t KTIME_PER_MILLISECOND = 46186158;
+	// linear interpolation with the flags the SDK writes next to it
+	constexpr int32_t KEY_ATTR_FLAGS_LINEAR = 0x6104;
+	// arrays smaller than this are stored raw, deflate doesn't win anything on them
+	constexpr size_t DEFLATE_THRESHOLD = 256;
+
+	struct Property
+	{
+		char type;
+		// scalars and strings, already encoded
+		std::string value;
+		// arrays point at their elements, the data must outlive the write
+		const void* array_data = nullptr;
+		uint32_t array_count = 0;
+		uint32_t array_size = 0;
+		std::shared_ptr<const std::vector<uint8_t>> deflated;
+	};
+
+	// deque so references to children stay valid while siblings are added
+	struct Node
+	{
+		std::string name;
+		std::vector<Property> properties;
+		std::deque<Node> children;
+
+		Node& AddChild(std::string_view child_name)
+		{
+			auto& child = children.emplace_back();
+			child.name = child_name;
+			return child;
+		}
+
+		template<class T>
+		Node& AddScalar(char type, T value)
+		{
+			auto& property = properties.emplace_back();
+			property.type = type;
+			property.value.assign(reinterpret_cast<const char*>(&value), sizeof(T));
+			return *this;
+		}
+
+		Node& AddBool(bool value) { return AddScalar<uint8_t>('C', value ? 1 : 0); }
+		Node& AddInt32(int32_t value) { return AddScalar('I', value); }
+		Node& AddInt64(int64_t value) { return AddScalar('L', value); }
+		Node& AddDouble(double value) { return AddScalar('D', value); }
+
+		Node& AddString(std::string_view value, char type = 'S')
+		{
+			auto& property = properties.emplace_back();
+			property.type = type;
+			auto size = static_cast<uint32_t>(value.size());
+			property.value.assign(reinterpret_cast<const char*>(&size), sizeof(size));
+			property.value.append(value);
+			return *this;
+		}
+
+		template<class T>
+		Node& AddArray(std::span<const T> values)
+		{
+			auto& property = properties.emplace_back();
+			if constexpr (std::is_same_v<T, float>) property.type = 'f';
+			else if constexpr (std::is_same_v<T, double>) property.type = 'd';
+			else if constexpr (std::is_same_v<T, int32_t>) property.type = 'i';
+			else if constexpr (std::is_same_v<T, int64_t>) property.type = 'l';
+			else static_assert(sizeof(T) == 0, "unsupported FBX array type");
+			// the array header is 32 bit in every version
+			if (values.size_bytes() > std::numeric_limits<uint32_t>::max())
+			{
+				throw std::invalid_argument(std::format("{} byte array doesn't fit a binary FBX array property\n", values.size_bytes()));
+			}
+			property.array_data = values.data();
+			property.array_count = static_cast<uint32_t>(values.size());
+			property.array_size = static_cast<uint32_t>(values.size_bytes());
+			return *this;
+		}
+	};
+
+	// "name\0\1Class", how binary FBX stores "Class::name"
+	std::string ObjectName(std::string_view name, std::string_view class_name)
+	{
+		std::string result(name);
+		result += '\0';
+		result += '\1';
+		result += class_name;
+		return result;
+	}
+
+	// P: name, type, label, flags, values...
+	Node& AddP(Node& properties70, std::string_view name, std::string_view type, std::string_view label, std::string_view flags)
+	{
+		return properties70.AddChild("P").AddString(name).AddString(type).AddString(label).AddString(flags);
+	}
+
+	Node& AddP(Node& properties70, std::string_view name, std::string_view type, const Vector3& value)
+	{
+		return AddP(properties70, name, type, "", "A").AddDouble(value.x).AddDouble(value.y).AddDouble(value.z);
+	}
+
+	// Builds the node tree. Arrays that have no matching IR layout (doubles, strided curve
+	// components, negated polygon ends) are converted once into storage owned by the builder.
+	class DocumentBuilder
+	{
+	public:
+		explicit DocumentBuilder(uint32_t version)
+			: _version(version)
+		{
+		}
+
+		void Build(const Skeleton& skeleton, std::span<const ir::MeshGroup> mesh_groups, std::span<const ir::AnimationClip> clips)
+		{
+			int64_t stop_time = 0;
+			for (auto&& clip : clips)
+			{
+				if (!clip.key_times.empty())
+				{
+					stop_time = std::max(stop_time, clip.key_times.back() * KTIME_PER_MILLISECOND);
+				}
+			}
+
+			AddHeader();
+			AddGlobalSettings(stop_time);
+
+			auto& documents = _root.AddChild("Documents");
+			documents.AddChild("Count").AddInt32(1);
+			auto& document = documents.AddChild("Document").AddInt64(NextId()).AddString("").AddString("Scene");
+			document.AddChild("Properties70");
+			document.AddChild("RootNode").AddInt64(0);
+			_root.AddChild("References");
+
+			auto& definitions = _root.AddChild("Definitions");
+			_objects = &_root.AddChild("Objects");
+			_connections = &_root.AddChild("Connections");
+
+			auto root_model = AddModel("Root", "Null", nullptr);
+			Connect(root_model, 0);
+
+			auto bone_count = static_cast<int>(skeleton.GetBoneCount());
+			std::vector<int64_t> bone_models(bone_count);
+			for (int bone = 0; bone < bone_count; bone++)
+			{
+				auto is_root = skeleton.parents[bone] == -1;
+				auto type = is_root ? "Root" : "LimbNode";
+				bone_models[bone] = AddModel(skeleton.names[bone], type, &skeleton, bone);
+				Connect(bone_models[bone], is_root ? root_model : bone_models[skeleton.parents[bone]]);
+
+				auto attribute_id = NextId();
+				auto& attribute = AddObject("NodeAttribute", attribute_id, ObjectName(skeleton.names[bone], "NodeAttribute"), type);
+				AddP(attribute.AddChild("Properties70"), "Size", "double", "Number", "").AddDouble(100.0);
+				if (is_root)
+				{
+					attribute.AddChild("TypeFlags").AddString("Null").AddString("Skeleton").AddString("Root");
+				}
+				else
+				{
+					attribute.AddChild("TypeFlags").AddString("Skeleton");
+				}
+				Connect(attribute_id, bone_models[bone]);
+			}
+
+			std::vector<int64_t> mesh_models;
+			for (auto&& group : mesh_groups)
+			{
+				auto mesh_model = AddMeshGroup(group, skeleton, bone_models, root_model);
+				if (mesh_model != -1)
+				{
+					mesh_models.push_back(mesh_model);
+				}
+			}
+
+			AddBindPose(skeleton, bone_models, mesh_models);
+
+			for (auto&& clip : clips)
+			{
+				AddAnimationClip(clip, bone_models);
+			}
+
+			AddTakes(clips);
+
+			definitions.AddChild("Version").AddInt32(100);
+			int32_t total_count = 1;
+			for (auto&& [type, count] : _object_counts)
+			{
+				total_count += count;
+			}
+			definitions.AddChild("Count").AddInt32(total_count);
+			definitions.AddChild("ObjectType").AddString("GlobalSettings").AddChild("Count").AddInt32(1);
+			for (auto&& [type, count] : _object_counts)
+			{
+				definitions.AddChild("ObjectType").AddString(type).AddChild("Count").AddInt32(count);
+			}
+		}
+
+		// deflates every distinct array above the threshold, properties sharing the same data and size are compressed once
+		void Deflate(unsigned thread_count)
+		{
+			ArrayMap arrays;
+			CollectArrays(_root, arrays);
+
+			std::vector<std::pair<std::span<const uint8_t>, std::vector<Property*>*>> jobs;
+			for (auto&& [array, properties] : arrays)
+			{
+				auto [data, size] = array;
+				if (size >= DEFLATE_THRESHOLD)
+				{
+					jobs.push_back({ { static_cast<const uint8_t*>(data), size }, &properties });
+				}
+			}
+
+			parallel::For(jobs.size(), thread_count, [&](size_t job)
+			{
+				auto deflated = std::make_shared<const std::vector<uint8_t>>(zlib::Compress(jobs[job].first));
+				// stored raw when deflate doesn't pay off
+				if (deflated->size() < jobs[job].first.size())
+				{
+					for (auto property : *jobs[job].second)
+					{
+						property->deflated = deflated;
+					}
+				}
+			});
+		}
+
+		void Write(const std::filesystem::path& path) const
+		{
+			// 7400 node records store their end offset and property size in 32 bits
+			if (!IsWide())
+			{
+				uint64_t end_offset = sizeof(HEADER_MAGIC) - 1 + sizeof(_version) + GetSentinelSize();
+				for (size_t i = 0; i < _root.children.size(); i++)
+				{
+					end_offset += GetNodeSize(_root.children[i], i + 1 == _root.children.size());
+				}
+				if (end_offset > std::numeric_limits<uint32_t>::max())
+				{
+					throw std::invalid_argument(std::format("'{}' would be {} bytes, more than FBX {} can address, use --fbx-version 7500\n",
+						path.string(), end_offset, _version));
+				}
+			}
+
+			std::ofstream stream(path, std::ios::binary);
+			if (!stream)
+			{
+				throw std::logic_error(std::format("Failed to open '{}'\n", path.string()));
+			}
+
+			uint64_t offset = 0;
+			auto write = [&](const void* data, size_t size)
+			{
+				stream.write(static_cast<const char*>(data), size);
+				offset += size;
+			};
+
+			write(HEADER_MAGIC, sizeof(HEADER_MAGIC) - 1);
+			write(&_version, sizeof(_version));
+
+			for (size_t i = 0; i < _root.children.size(); i++)
+			{
+				WriteNode(_root.children[i], i + 1 == _root.children.size(), offset, write);
+			}
+			WriteSentinel(write);
+
+			write(FOOTER_ID, sizeof(FOOTER_ID));
+			constexpr uint8_t zeros[128] = {};
+			write(zeros, 4);
+			// padding to 16, a full 16 bytes if already aligned
+			auto padding = ((offset + 15) & ~uint64_t(15)) - offset;
+			write(zeros, padding ? padding : 16);
+			write(&_version, sizeof(_version));
+			write(zeros, 120);
+			write(FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+
+			if (!stream)
+			{
+				throw std::logic_error(std::format("Failed to write '{}'\n", path.string()));
+			}
+		}
+
+	private:
+		// properties by (data, size), a property viewing a prefix of another array is a different array
+		using ArrayMap = std::map<std::pair<const void*, uint32_t>, std::vector<Property*>>;
+
+		bool IsWide() const
+		{
+			return _version >= 7500;
+		}
+
+		size_t GetSentinelSize() const
+		{
+			return IsWide() ? 25 : 13;
+		}
+
+		// same rule as the SDK: a null record ends every child list, and empty nodes unless they are the last sibling
+		static bool NeedsSentinel(const Node& node, bool is_last)
+		{
+			return !node.children.empty() || (node.properties.empty() && !is_last) ||
+				node.name == "AnimationStack" || node.name == "AnimationLayer";
+		}
+
+		static size_t GetPropertySize(const Property& property)
+		{
+			if (property.array_data)
+			{
+				return 1 + 12 + (property.deflated ? property.deflated->size() : property.array_size);
+			}
+			return 1 + property.value.size();
+		}
+
+		size_t GetNodeSize(const Node& node, bool is_last) const
+		{
+			auto size = GetSentinelSize() + node.name.size();
+			for (auto&& property : node.properties)
+			{
+				size += GetPropertySize(property);
+			}
+			for (size_t i = 0; i < node.children.size(); i++)
+			{
+				size += GetNodeSize(node.children[i], i + 1 == node.children.size());
+			}
+			if (NeedsSentinel(node, is_last))
+			{
+				size += GetSentinelSize();
+			}
+			return size;
+		}
+
+		template<class Write>
+		void WriteSentinel(Write& write) const
+		{
+			constexpr uint8_t zeros[25] = {};
+			write(zeros, GetSentinelSize());
+		}
+
+		template<class Write>
+		void WriteNode(const Node& node, bool is_last, uint64_t& offset, Write& write) const
+		{
+			uint64_t end_offset = offset + GetNodeSize(node, is_last);
+			uint64_t properties_size = 0;
+			for (auto&& property : node.properties)
+			{
+				properties_size += GetPropertySize(property);
+			}
+
+			if (IsWide())
+			{
+				uint64_t header[] = { end_offset, node.properties.size(), properties_size };
+				write(header, sizeof(header));
+			}
+			else
+			{
+				uint32_t header[] = { static_cast<uint32_t>(end_offset), static_cast<uint32_t>(node.properties.size()), static_cast<uint32_t>(properties_size) };
+				write(header, sizeof(header));
+			}
+			auto name_size = static_cast<uint8_t>(node.name.size());
+			write(&name_size, 1);
+			write(node.name.data(), node.name.size());
+
+			for (auto&& property : node.properties)
+			{
+				write(&property.type, 1);
+				if (property.array_data)
+				{
+					uint32_t encoding = property.deflated ? 1 : 0;
+					uint32_t size = property.deflated ? static_cast<uint32_t>(property.deflated->size()) : property.array_size;
+					uint32_t array_header[] = { property.array_count, encoding, size };
+					write(array_header, sizeof(array_header));
+					write(property.deflated ? property.deflated->data() : property.array_data, size);
+				}
+				else
+				{
+					write(property.value.data(), property.value.size());
+				}
+			}
+
+			for (size_t i = 0; i < node.children.size(); i++)
+			{
+				WriteNode(node.children[i], i + 1 == node.children.size(), offset, write);
+			}
+			if (NeedsSentinel(node, is_last))
+			{
+				WriteSentinel(write);
+			}
+		}
+
+		static void CollectArrays(Node& node, ArrayMap& arrays)
+		{
+			for (auto&& property : node.properties)
+			{
+				if (property.array_data && property.array_size)
+				{
+					arrays[{ property.array_data, property.array_size }].push_back(&property);
+				}
+			}
+			for (auto&& child : node.children)
+			{
+				CollectArrays(child, arrays);
+			}
+		}
+
+		int64_t NextId()
+		{
+			return _next_id++;
+		}
+
+		void Connect(int64_t child, int64_t parent)
+		{
+			_connections->AddChild("C").AddString("OO").AddInt64(child).AddInt64(parent);
+		}
+
+		void ConnectProperty(int64_t child, int64_t parent, std::string_view property)
+		{
+			_connections->AddChild("C").AddString("OP").AddInt64(child).AddInt64(parent).AddString(property);
+		}
+
+		Node& AddObject(std::string_view type, int64_t id, std::string_view name, std::string_view sub_type)
+		{
+			_object_counts[std::string(type)]++;
+			return _objects->AddChild(type).AddInt64(id).AddString(name).AddString(sub_type);
+		}
+
+		template<class T>
+		std::vector<T>& AddStorage(size_t count)
+		{
+			if constexpr (std::is_same_v<T, double>) return _double_storage.emplace_back(count);
+			else if constexpr (std::is_same_v<T, float>) return _float_storage.emplace_back(count);
+			else if constexpr (std::is_same_v<T, int32_t>) return _int32_storage.emplace_back(count);
+			else return _int64_storage.emplace_back(count);
+		}
+
+		std::span<const double> AddMatrix(const Matrix4x4& matrix)
+		{
+			auto& storage = AddStorage<double>(16);
+			std::copy(std::begin(matrix.raw), std::end(matrix.raw), storage.begin());
+			return storage;
+		}
+
+		void AddHeader()
+		{
+			auto& header = _root.AddChild("FBXHeaderExtension");
+			header.AddChild("FBXHeaderVersion").AddInt32(1003);
+			header.AddChild("FBXVersion").AddInt32(static_cast<int32_t>(_version));
+			header.AddChild("EncryptionType").AddInt32(0);
+			auto& time_stamp = header.AddChild("CreationTimeStamp");
+			time_stamp.AddChild("Version").AddInt32(1000);
+			time_stamp.AddChild("Year").AddInt32(1970);
+			time_stamp.AddChild("Month").AddInt32(1);
+			time_stamp.AddChild("Day").AddInt32(1);
+			time_stamp.AddChild("Hour").AddInt32(10);
+			time_stamp.AddChild("Minute").AddInt32(0);
+			time_stamp.AddChild("Second").AddInt32(0);
+			time_stamp.AddChild("Millisecond").AddInt32(0);
+			header.AddChild("Creator").AddString(CREATOR);
+
+			_root.AddChild("FileId").AddString(std::string_view(reinterpret_cast<const char*>(FILE_ID), sizeof(FILE_ID)), 'R');
+			_root.AddChild("CreationTime").AddString(CREATION_TIME);
+			_root.AddChild("Creator").AddString(CREATOR);
+		}
+
+		// Data is written as is in the DXG axes, the ones the SDK path tags "XyZ": Y up, X right, Z negated
+		// against the FBX default. Declaring them lets importers convert like DeepConvertScene does for the SDK output.
+		void AddGlobalSettings(int64_t stop_time)
+		{
+			auto& settings = _root.AddChild("GlobalSettings");
+			settings.AddChild("Version").AddInt32(1000);
+			auto& properties = settings.AddChild("Properties70");
+			AddP(properties, "UpAxis", "int", "Integer", "").AddInt32(1);
+			AddP(properties, "UpAxisSign", "int", "Integer", "").AddInt32(1);
+			AddP(properties, "FrontAxis", "int", "Integer", "").AddInt32(2);
+			AddP(properties, "FrontAxisSign", "int", "Integer", "").AddInt32(-1);
+			AddP(properties, "CoordAxis", "int", "Integer", "").AddInt32(0);
+			AddP(properties, "CoordAxisSign", "int", "Integer", "").AddInt32(1);
+			AddP(properties, "OriginalUpAxis", "int", "Integer", "").AddInt32(1);
+			AddP(properties, "OriginalUpAxisSign", "int", "Integer", "").AddInt32(1);
+			AddP(properties, "UnitScaleFactor", "double", "Number", "").AddDouble(1.0);
+			AddP(properties, "OriginalUnitScaleFactor", "double", "Number", "").AddDouble(1.0);
+			AddP(properties, "TimeMode", "enum", "", "").AddInt32(0);
+			AddP(properties, "TimeSpanStart", "KTime", "Time", "").AddInt64(0);
+			AddP(properties, "TimeSpanStop", "KTime", "Time", "").AddInt64(stop_time);
+		}
+
+		// bone models take their bind pose TRS from the skeleton
+		int64_t AddModel(std::string_view name, std::string_view type, const Skeleton* skeleton, int bone = -1)
+		{
+			auto id = NextId();
+			auto& model = AddObject("Model", id, ObjectName(name, "Model"), type);
+			model.AddChild("Version").AddInt32(232);
+			auto& properties = model.AddChild("Properties70");
+			if (skeleton)
+			{
+				AddP(properties, "Lcl Translation", "Lcl Translation", skeleton->local_translations[bone]);
+				AddP(properties, "Lcl Rotation", "Lcl Rotation", skeleton->local_rotations[bone]);
+				AddP(properties, "Lcl Scaling", "Lcl Scaling", skeleton->local_scales[bone]);
+			}
+			model.AddChild("Shading").AddBool(true);
+			model.AddChild("Culling").AddString("CullingOff");
+			return id;
+		}
+
+		// -1 if the group has no geometry, its model is still added
+		int64_t AddMeshGroup(const ir::MeshGroup& group, const Skeleton& skeleton, std::span<const int64_t> bone_models, int64_t root_model)
+		{
+			auto vertex_count = group.GetVertexCount();
+			auto has_mesh = group.has_geometry && vertex_count != 0;
+			auto model = AddModel(group.name, has_mesh ? "Mesh" : "Null", nullptr);
+			Connect(model, root_model);
+			if (!has_mesh)
+			{
+				return -1;
+			}
+
+			auto geometry_id = NextId();
+			auto& geometry = AddObject("Geometry", geometry_id, ObjectName(group.name, "Geometry"), "Mesh");
+			Connect(geometry_id, model);
+
+			auto& vertices = AddStorage<double>(vertex_count * 3);
+			auto& normals = AddStorage<double>(vertex_count * 3);
+			auto& uvs = AddStorage<double>(vertex_count * 2);
+			for (size_t i = 0; i < vertex_count; i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					vertices[i * 3 + j] = group.positions[i].raw[j];
+					normals[i * 3 + j] = group.normals[i].raw[j];
+				}
+				uvs[i * 2 + 0] = group.uvs[i].x;
+				uvs[i * 2 + 1] = 1.0 - group.uvs[i].y;
+			}
+
+			// the last index of every polygon is stored as ~index
+			auto& polygon_vertices = AddStorage<int32_t>(group.indices.size());
+			for (size_t i = 0; i < group.indices.size(); i++)
+			{
+				auto index = static_cast<int32_t>(group.indices[i]);
+				polygon_vertices[i] = i % 3 == 2 ? ~index : index;
+			}
+
+			geometry.AddChild("Vertices").AddArray(std::span<const double>(vertices));
+			geometry.AddChild("PolygonVertexIndex").AddArray(std::span<const int32_t>(polygon_vertices));
+			geometry.AddChild("GeometryVersion").AddInt32(124);
+
+			auto add_layer_element = [&](std::string_view type, int index, std::string_view name, std::string_view data_name, std::span<const double> data)
+			{
+				auto& element = geometry.AddChild(type).AddInt32(index);
+				element.AddChild("Version").AddInt32(101);
+				element.AddChild("Name").AddString(name);
+				element.AddChild("MappingInformationType").AddString("ByVertice");
+				element.AddChild("ReferenceInformationType").AddString("Direct");
+				element.AddChild(data_name).AddArray(data);
+			};
+
+			add_layer_element("LayerElementNormal", 0, "", "Normals", normals);
+			add_layer_element("LayerElementUV", 0, "uv1", "UV", uvs);
+			if (group.has_uvs_2)
+			{
+				auto& uvs_2 = AddStorage<double>(vertex_count * 2);
+				for (size_t i = 0; i < vertex_count; i++)
+				{
+					uvs_2[i * 2 + 0] = group.uvs_2[i].x;
+					uvs_2[i * 2 + 1] = 1.0 - group.uvs_2[i].y;
+				}
+				add_layer_element("LayerElementUV", 1, "uv2", "UV", uvs_2);
+			}
+			if (group.has_colors)
+			{
+				auto& colors = AddStorage<double>(vertex_count * 4);
+				for (size_t i = 0; i < vertex_count; i++)
+				{
+					const auto& color = group.colors[i];
+					colors[i * 4 + 0] = color.R / 255.0;
+					colors[i * 4 + 1] = color.G / 255.0;
+					colors[i * 4 + 2] = color.B / 255.0;
+					colors[i * 4 + 3] = color.A / 255.0;
+				}
+				add_layer_element("LayerElementColor", 0, "", "Colors", colors);
+			}
+
+			auto add_layer = [&](int index, std::initializer_list<std::string_view> types)
+			{
+				auto& layer = geometry.AddChild("Layer").AddInt32(index);
+				layer.AddChild("Version").AddInt32(100);
+				for (auto type : types)
+				{
+					auto& element = layer.AddChild("LayerElement");
+					element.AddChild("Type").AddString(type);
+					element.AddChild("TypedIndex").AddInt32(index);
+				}
+			};
+			if (group.has_colors)
+			{
+				add_layer(0, { "LayerElementNormal", "LayerElementUV", "LayerElementColor" });
+			}
+			else
+			{
+				add_layer(0, { "LayerElementNormal", "LayerElementUV" });
+			}
+			if (group.has_uvs_2)
+			{
+				add_layer(1, { "LayerElementUV" });
+			}
+
+			if (!group.skin_bones.empty())
+			{
+				AddSkin(group, skeleton, bone_models, geometry_id);
+			}
+			return model;
+		}
+
+		// one cluster per bone in the IR's first use order, influences bucketed in one pass over the vertices
+		void AddSkin(const ir::MeshGroup& group, const Skeleton& skeleton, std::span<const int64_t> bone_models, int64_t geometry_id)
+		{
+			auto skin_id = NextId();
+			auto& skin = AddObject("Deformer", skin_id, ObjectName("", "Deformer"), "Skin");
+			skin.AddChild("Version").AddInt32(101);
+			skin.AddChild("Link_DeformAcuracy").AddDouble(50.0);
+			Connect(skin_id, geometry_id);
+
+			std::vector<int> bone_clusters(skeleton.GetBoneCount(), -1);
+			for (size_t i = 0; i < group.skin_bones.size(); i++)
+			{
+				bone_clusters[group.skin_bones[i]] = static_cast<int>(i);
+			}
+
+			std::vector<std::vector<int32_t>> indices(group.skin_bones.size());
+			std::vector<std::vector<double>> weights(group.skin_bones.size());
+			for (size_t i = 0; i < group.GetVertexCount(); i++)
+			{
+				for (int j = 2; j >= 0; j--)
+				{
+					auto weight = group.weights[i * 3 + j];
+					if (weight == 0.f)
+					{
+						continue;
+					}
+
+					auto cluster = bone_clusters[group.joints[i * 3 + j]];
+					indices[cluster].push_back(static_cast<int32_t>(i));
+					weights[cluster].push_back(weight);
+				}
+			}
+
+			Matrix4x4 identity;
+			identity.m[0][0] = identity.m[1][1] = identity.m[2][2] = identity.m[3][3] = 1.f;
+			auto transform = AddMatrix(identity);
+
+			for (size_t i = 0; i < group.skin_bones.size(); i++)
+			{
+				auto bone = group.skin_bones[i];
+				auto cluster_id = NextId();
+				auto& cluster = AddObject("Deformer", cluster_id, ObjectName(skeleton.names[bone], "SubDeformer"), "Cluster");
+				cluster.AddChild("Version").AddInt32(100);
+				cluster.AddChild("UserData").AddString("").AddString("");
+				cluster.AddChild("Mode").AddString("Total1");
+				cluster.AddChild("Indexes").AddArray(std::span<const int32_t>(_int32_storage.emplace_back(std::move(indices[i]))));
+				cluster.AddChild("Weights").AddArray(std::span<const double>(_double_storage.emplace_back(std::move(weights[i]))));
+				cluster.AddChild("Transform").AddArray(transform);
+				// bind pose from the batch solve, same as the SDK path
+				cluster.AddChild("TransformLink").AddArray(AddMatrix(skeleton.global_bind_matrices[bone]));
+				Connect(cluster_id, skin_id);
+				Connect(bone_models[bone], cluster_id);
+			}
+		}
+
+		void AddBindPose(const Skeleton& skeleton, std::span<const int64_t> bone_models, std::span<const int64_t> mesh_models)
+		{
+			if (mesh_models.empty() || bone_models.empty())
+			{
+				return;
+			}
+
+			auto& pose = AddObject("Pose", NextId(), ObjectName("BIND_POSES", "Pose"), "BindPose");
+			pose.AddChild("Type").AddString("BindPose");
+			pose.AddChild("Version").AddInt32(100);
+			pose.AddChild("NbPoseNodes").AddInt32(static_cast<int32_t>(mesh_models.size() + bone_models.size()));
+
+			Matrix4x4 identity;
+			identity.m[0][0] = identity.m[1][1] = identity.m[2][2] = identity.m[3][3] = 1.f;
+			auto identity_matrix = AddMatrix(identity);
+			for (auto mesh_model : mesh_models)
+			{
+				auto& pose_node = pose.AddChild("PoseNode");
+				pose_node.AddChild("Node").AddInt64(mesh_model);
+				pose_node.AddChild("Matrix").AddArray(identity_matrix);
+			}
+			for (size_t bone = 0; bone < bone_models.size(); bone++)
+			{
+				auto& pose_node = pose.AddChild("PoseNode");
+				pose_node.AddChild("Node").AddInt64(bone_models[bone]);
+				pose_node.AddChild("Matrix").AddArray(AddMatrix(skeleton.global_bind_matrices[bone]));
+			}
+		}
+
+		// curve node with its 3 component curves, values[k] is the key at key_times[k]
+		void AddCurveNode(std::string_view name, std::string_view property, std::span<const Vector3> values, std::span<const int64_t> key_times,
+			int64_t layer_id, int64_t model_id)
+		{
+			auto curve_node_id = NextId();
+			auto& curve_node = AddObject("AnimationCurveNode", curve_node_id, ObjectName(name, "AnimCurveNode"), "");
+			auto& properties = curve_node.AddChild("Properties70");
+			Connect(curve_node_id, layer_id);
+			ConnectProperty(curve_node_id, model_id, property);
+
+			constexpr std::string_view component_names[] = { "d|X", "d|Y", "d|Z" };
+			for (int component = 0; component < 3; component++)
+			{
+				AddP(properties, component_names[component], "Number", "", "A").AddDouble(values.front().raw[component]);
+
+				auto& key_values = AddStorage<float>(values.size());
+				for (size_t i = 0; i < values.size(); i++)
+				{
+					key_values[i] = values[i].raw[component];
+				}
+
+				auto curve_id = NextId();
+				auto& curve = AddObject("AnimationCurve", curve_id, ObjectName("", "AnimCurve"), "");
+				curve.AddChild("Default").AddDouble(key_values.front());
+				curve.AddChild("KeyVer").AddInt32(4008);
+				curve.AddChild("KeyTime").AddArray(key_times);
+				curve.AddChild("KeyValueFloat").AddArray(std::span<const float>(key_values));
+				curve.AddChild("KeyAttrFlags").AddArray(std::span<const int32_t>(_key_attr_flags));
+				curve.AddChild("KeyAttrDataFloat").AddArray(std::span<const float>(_key_attr_data));
+				curve.AddChild("KeyAttrRefCount").AddArray(std::span<const int32_t>(AddStorage<int32_t>(1) = { static_cast<int32_t>(values.size()) }));
+				ConnectProperty(curve_id, curve_node_id, component_names[component]);
+			}
+		}
+
+		void AddAnimationClip(const ir::AnimationClip& clip, std::span<const int64_t> bone_models)
+		{
+			if (clip.key_times.empty())
+			{
+				return;
+			}
+
+			auto stack_id = NextId();
+			auto& stack = AddObject("AnimationStack", stack_id, ObjectName(clip.name, "AnimStack"), "");
+			auto& stack_properties = stack.AddChild("Properties70");
+			auto stop_time = clip.key_times.back() * KTIME_PER_MILLISECOND;
+			AddP(stack_properties, "LocalStop", "KTime", "Time", "").AddInt64(stop_time);
+			AddP(stack_properties, "ReferenceStop", "KTime", "Time", "").AddInt64(stop_time);
+
+			auto layer_id = NextId();
+			AddObject("AnimationLayer", layer_id, ObjectName(std::format("{}_Layer", clip.name), "AnimLayer"), "");
+			Connect(layer_id, stack_id);
+
+			// one key time array shared by every curve keeping all of the clip's keys
+			auto& key_times = AddStorage<int64_t>(clip.key_times.size());
+			for (size_t i = 0; i < key_times.size(); i++)
+			{
+				key_times[i] = clip.key_times[i] * KTIME_PER_MILLISECOND;
+			}
+			// reduced channels get the times of their kept keys, shared by the 3 component curves
+			auto channel_times = [&](std::span<const uint32_t> keys) -> std::span<const int64_t>
+			{
+				if (keys.empty())
+				{
+					return key_times;
+				}
+				auto& times = AddStorage<int64_t>(keys.size());
+				for (size_t i = 0; i < keys.size(); i++)
+				{
+					times[i] = key_times[keys[i]];
+				}
+				return times;
+			};
+
+			for (auto&& track : clip.tracks)
+			{
+				auto model_id = bone_models[track.bone];
+				AddCurveNode("T", "Lcl Translation", track.translations, channel_times(track.translation_keys), layer_id, model_id);
+				AddCurveNode("R", "Lcl Rotation", track.euler_rotations, channel_times(track.rotation_keys), layer_id, model_id);
+				AddCurveNode("S", "Lcl Scaling", track.scales, channel_times(track.scale_keys), layer_id, model_id);
+			}
+		}
+
+		void AddTakes(std::span<const ir::AnimationClip> clips)
+		{
+			auto& takes = _root.AddChild("Takes");
+			takes.AddChild("Current").AddString("");
+			for (auto&& clip : clips)
+			{
+				if (clip.key_times.empty())
+				{
+					continue;
+				}
+
+				auto stop_time = clip.key_times.back() * KTIME_PER_MILLISECOND;
+				auto& take = takes.AddChild("Take").AddString(clip.name);
+				take.AddChild("FileName").AddString(std::format("{}.tak", clip.name));
+				take.AddChild("LocalTime").AddInt64(0).AddInt64(stop_time);
+				take.AddChild("ReferenceTime").AddInt64(0).AddInt64(stop_time);
+			}
+		}
+
+		uint32_t _version;
+		Node _root;
+		Node* _objects = nullptr;
+		Node* _connections = nullptr;
+		int64_t _next_id = 1000000;
+		std::map<std::string, int32_t> _object_counts;
+
+		std::deque<std::vector<double>> _double_storage;
+		std::deque<std::vector<float>> _float_storage;
+		std::deque<std::vector<int32_t>> _int32_storage;
+		std::deque<std::vector<int64_t>> _int64_storage;
+		const std::vector<int32_t> _key_attr_flags = { KEY_ATTR_FLAGS_LINEAR };
+		const std::vector<float> _key_attr_data = { 0.f, 0.f, 9.419963346924634e-30f, 0.f };
+	};
+}
+
+namespace fbx
+{
+	void WriteFbx(const std::filesystem::path& path, const Skeleton& skeleton, std::span<const ir::MeshGroup> mesh_groups,
+		std::span<const ir::AnimationClip> clips, uint32_t version, unsigned thread_count)
+	{
+		if (version != 7400 && version != 7500)
+		{
+			throw std::invalid_argument(std::format("Unsupported FBX version {}\n", version));
+		}
+
+		DocumentBuilder builder(version);
+		{
+			trace::Scope scope("fbx::Build");
+			builder.Build(skeleton, mesh_groups, clips);
+		}
+		{
+			trace::Scope scope("fbx::Deflate");
+			builder.Deflate(thread_count);
+		}
+		trace::Scope scope("fbx::Write");
+		builder.Write(path);
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <span>
+#include <cstdint>
+#include <filesystem>
+
+#include "scene_ir.h"
+
+// Binary FBX output straight from the IR, no FBX SDK involved.
+// Writes the same objects the SDK path builds (skeleton, skinned mesh groups, bind pose, linear
+// TRS curves), every array property is serialized from one contiguous buffer.
+namespace fbx
+{
+	// version is 7400 or 7500. Arrays above a few hundred bytes are deflated on thread_count
+	// threads, 0 for one per core. Throws std::logic_error if the file can't be written and
+	// std::invalid_argument if a 7400 file would pass the 4 GB its 32 bit offsets address.
+	void WriteFbx(const std::filesystem::path& path, const Skeleton& skeleton, std::span<const ir::MeshGroup> mesh_groups,
+		std::span<const ir::AnimationClip> clips, uint32_t version = 7400, unsigned thread_count = 0);
+}
@@ -0,0 +1,553 @@
+#include "fixtures.h"
+
+#include <span>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <format>
+#include <cstring>
+#include <fstream>
+#include <charconv>
+#include <algorithm>
+#include <stdexcept>
+
+#include "dxg.h"
+#include "mrb.h"
+
+namespace
+{
+	// int16 VertexDataIndices
+	constexpr uint32_t MAX_ATTRIBUTE_POOL_SIZE = std::numeric_limits<int16_t>::max();
+	// uint16 IndexMapElement
+	constexpr uint32_t MAX_KEY_POOL_SIZE = std::numeric_limits<uint16_t>::max();
+	constexpr uint32_t MAX_WEIGHT_BONES = 8;
+	// 30 fps
+	constexpr uint32_t KEYFRAME_INTERVAL_MS = 33;
+
+	struct Field
+	{
+		std::string_view name;
+		uint32_t fixtures::Parameters::* value;
+	};
+
+	constexpr Field FIELDS[] = {
+		{ "groups", &fixtures::Parameters::groups },
+		{ "blocks", &fixtures::Parameters::blocks },
+		{ "meshes", &fixtures::Parameters::meshes },
+		{ "vertices", &fixtures::Parameters::vertices },
+		{ "faces", &fixtures::Parameters::faces },
+		{ "bones", &fixtures::Parameters::bones },
+		{ "weight_bones", &fixtures::Parameters::weight_bones },
+		{ "clips", &fixtures::Parameters::clips },
+		{ "keyframes", &fixtures::Parameters::keyframes },
+		{ "seed", &fixtures::Parameters::seed }
+	};
+
+	struct Switch
+	{
+		std::string_view name;
+		bool fixtures::Parameters::* value;
+	};
+
+	constexpr Switch SWITCHES[] = {
+		{ "uvs_2", &fixtures::Parameters::uvs_2 },
+		{ "colors", &fixtures::Parameters::colors }
+	};
+
+	template<class T>
+	void Append(std::vector<uint8_t>& buffer, const T& value)
+	{
+		auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	template<class T>
+	void Patch(std::vector<uint8_t>& buffer, size_t offset, const T& value)
+	{
+		std::memcpy(buffer.data() + offset, &value, sizeof(T));
+	}
+
+	// null terminated names, the list ends with an empty one
+	std::vector<uint8_t> JoinNames(std::span<const std::string> names)
+	{
+		std::vector<uint8_t> result;
+		for (auto&& name : names)
+		{
+			result.insert(result.end(), name.begin(), name.end());
+			result.push_back(0);
+		}
+		result.push_back(0);
+		return result;
+	}
+
+	void AppendStringList(std::vector<uint8_t>& buffer, std::span<const std::string> names)
+	{
+		auto data = JoinNames(names);
+		Append(buffer, dxg::StringList{ static_cast<uint32_t>(data.size()) });
+		buffer.insert(buffer.end(), data.begin(), data.end());
+	}
+
+	// block data is padded to 4 bytes from the start of the animation header, the buffer has to start there
+	void AppendDataBlock(std::vector<uint8_t>& buffer, uint32_t elements_count, uint32_t element_size, const void* data)
+	{
+		Append(buffer, mrb::AnimationDataBlock{ elements_count, element_size });
+		auto bytes = static_cast<const uint8_t*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size_t(elements_count) * element_size);
+		buffer.resize(buffer.size() + (-buffer.size() & 3));
+	}
+
+	template<class T>
+	void AppendDataBlock(std::vector<uint8_t>& buffer, std::span<const T> data)
+	{
+		AppendDataBlock(buffer, static_cast<uint32_t>(data.size()), sizeof(T), data.data());
+	}
+
+	void PatchStream(std::ofstream& stream, std::streamoff offset, uint32_t value)
+	{
+		auto end = stream.tellp();
+		stream.seekp(offset);
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		stream.seekp(end);
+	}
+
+	void WriteBuffer(std::ofstream& stream, const std::vector<uint8_t>& buffer)
+	{
+		stream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	}
+
+	uint32_t CheckDataSize(uint64_t size, std::string_view what)
+	{
+		if (size > std::numeric_limits<uint32_t>::max())
+		{
+			throw std::invalid_argument(std::format("{} data size {} doesn't fit in 32 bits, spread it over more groups or files\n", what, size));
+		}
+		return static_cast<uint32_t>(size);
+	}
+
+	std::string GetBoneName(uint32_t bone)
+	{
+		return std::format("bone_{}", bone);
+	}
+
+	std::vector<std::string> GetBoneNames(uint32_t bone_count)
+	{
+		std::vector<std::string> names;
+		for (uint32_t bone = 0; bone < bone_count; bone++)
+		{
+			names.push_back(GetBoneName(bone));
+		}
+		return names;
+	}
+
+	// bones form a binary tree, parents before children
+	int GetParentBone(uint32_t bone)
+	{
+		return bone ? static_cast<int>((bone - 1) / 2) : -1;
+	}
+
+	// rest position relative to the parent, children spread left and right
+	Vector3 GetBoneOffset(uint32_t bone)
+	{
+		if (!bone)
+		{
+			return { 0.f, 0.f, 0.f };
+		}
+		return { bone % 2 ? -0.1f : 0.1f, 0.2f, 0.f };
+	}
+
+	void Validate(const fixtures::Parameters& parameters)
+	{
+		if (parameters.meshes > std::numeric_limits<int8_t>::max())
+		{
+			throw std::invalid_argument(std::format("At most {} meshes per block, got {}\n", std::numeric_limits<int8_t>::max(), parameters.meshes));
+		}
+		if (parameters.vertices > std::numeric_limits<uint16_t>::max() || parameters.faces > std::numeric_limits<uint16_t>::max())
+		{
+			throw std::invalid_argument(std::format("At most {} vertices and faces per mesh, got {} and {}\n",
+				std::numeric_limits<uint16_t>::max(), parameters.vertices, parameters.faces));
+		}
+		if (parameters.faces && parameters.vertices < 3)
+		{
+			throw std::invalid_argument(std::format("Faces need at least 3 vertices per mesh, got {}\n", parameters.vertices));
+		}
+		if (!parameters.bones || parameters.bones > std::numeric_limits<int8_t>::max())
+		{
+			throw std::invalid_argument(std::format("Expected 1 to {} bones, got {}\n", std::numeric_limits<int8_t>::max(), parameters.bones));
+		}
+		if (parameters.weight_bones > std::min(MAX_WEIGHT_BONES, parameters.bones))
+		{
+			throw std::invalid_argument(std::format("At most {} weighted bones per mesh, got {}\n",
+				std::min(MAX_WEIGHT_BONES, parameters.bones), parameters.weight_bones));
+		}
+	}
+
+	// one MeshGroupDataHeader with its meshes and attribute pool
+	void AppendMeshGroupData(std::vector<uint8_t>& buffer, const fixtures::Parameters& parameters, uint32_t block_index, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> signed_unit(-1.f, 1.f);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		auto pool_size = std::min(parameters.meshes * parameters.vertices, MAX_ATTRIBUTE_POOL_SIZE);
+		auto skinned = parameters.weight_bones != 0;
+
+		dxg::MeshGroupDataHeader header{};
+		header.mesh_count = static_cast<int8_t>(parameters.meshes);
+		header.position_count = static_cast<uint16_t>(pool_size);
+		header.normal_count = static_cast<uint16_t>(pool_size);
+		header.uv_1_count = static_cast<uint16_t>(pool_size);
+		header.uv_2_count = static_cast<uint16_t>(parameters.uvs_2 ? pool_size : 0);
+		header.color_count = static_cast<uint16_t>(parameters.colors ? pool_size : 0);
+		// two weights per position, the third is what's left to 1
+		header.weights_count = skinned ? pool_size * 2 : 0;
+		Append(buffer, header);
+
+		for (uint32_t mesh_idx = 0; mesh_idx < parameters.meshes; mesh_idx++)
+		{
+			auto mesh_offset = buffer.size();
+
+			dxg::MeshHeader mesh_header{};
+			mesh_header.vertex_count = static_cast<uint16_t>(parameters.vertices);
+			mesh_header.face_count = static_cast<uint16_t>(parameters.faces);
+			mesh_header.weight_bone_count = static_cast<uint8_t>(parameters.weight_bones);
+			mesh_header.weight_bone_indices_count = skinned ? parameters.vertices * 3 : 0;
+			Append(buffer, mesh_header);
+
+			// meshes take consecutive pool entries and wrap around once it's used up, like meshes sharing vertices
+			for (uint32_t vertex_idx = 0; vertex_idx < parameters.vertices; vertex_idx++)
+			{
+				auto index = static_cast<int16_t>((mesh_idx * parameters.vertices + vertex_idx) % pool_size);
+				Append(buffer, dxg::VertexDataIndices{ index, index, index, index, index });
+			}
+
+			// a strip of neighbouring vertices, so index locality is close to what real meshes have
+			for (uint32_t face_idx = 0; face_idx < parameters.faces; face_idx++)
+			{
+				auto first = static_cast<uint16_t>(face_idx % (parameters.vertices - 2));
+				auto second = static_cast<uint16_t>(first + 1);
+				if (face_idx % 2)
+				{
+					Append(buffer, dxg::Face{ { second, first, static_cast<uint16_t>(first + 2) } });
+				}
+				else
+				{
+					Append(buffer, dxg::Face{ { first, second, static_cast<uint16_t>(first + 2) } });
+				}
+			}
+
+			std::vector<std::string> weight_bone_names;
+			auto first_bone = (block_index * parameters.meshes + mesh_idx) * parameters.weight_bones;
+			for (uint32_t bone_idx = 0; bone_idx < parameters.weight_bones; bone_idx++)
+			{
+				weight_bone_names.push_back(GetBoneName((first_bone + bone_idx) % parameters.bones));
+			}
+			AppendStringList(buffer, weight_bone_names);
+
+			for (uint32_t vertex_idx = 0; skinned && vertex_idx < parameters.vertices; vertex_idx++)
+			{
+				dxg::WeightIndices indices;
+				for (auto& index : indices.indices)
+				{
+					index = static_cast<int8_t>(random() % parameters.weight_bones);
+				}
+				Append(buffer, indices);
+			}
+
+			Patch(buffer, mesh_offset + offsetof(dxg::MeshHeader, data_size),
+				static_cast<uint32_t>(buffer.size() - mesh_offset - sizeof(dxg::MeshHeader)));
+		}
+
+		std::vector<Vector3> positions(pool_size);
+		for (auto& position : positions)
+		{
+			position = { signed_unit(random), signed_unit(random), signed_unit(random) };
+		}
+		buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(positions.data()), reinterpret_cast<const uint8_t*>(positions.data() + pool_size));
+
+		for (auto&& position : positions)
+		{
+			auto length = std::sqrt(position.x * position.x + position.y * position.y + position.z * position.z);
+			auto inv_length = length != 0.f ? 1.f / length : 0.f;
+			Append(buffer, Vector3{ position.x * inv_length, position.y * inv_length, position.z * inv_length });
+		}
+
+		for (uint32_t i = 0; i < header.uv_1_count + header.uv_2_count; i++)
+		{
+			Append(buffer, Vector2{ unit(random), unit(random) });
+		}
+
+		for (uint32_t i = 0; i < header.color_count; i++)
+		{
+			auto color = static_cast<uint32_t>(random());
+			Append(buffer, ColorRGBA{ static_cast<uint8_t>(color), static_cast<uint8_t>(color >> 8), static_cast<uint8_t>(color >> 16), 255 });
+		}
+
+		for (uint32_t i = 0; i < header.weights_count / 2; i++)
+		{
+			auto first = unit(random);
+			Append(buffer, dxg::BoneWeights{ { first, (1.f - first) * unit(random) } });
+		}
+	}
+
+	void AppendSkeleton(std::vector<uint8_t>& buffer, const fixtures::Parameters& parameters)
+	{
+		auto header_offset = buffer.size();
+		Append(buffer, dxg::SkeletonHeader{ parameters.bones, 0 });
+		AppendStringList(buffer, GetBoneNames(parameters.bones));
+
+		auto bone_count = static_cast<int>(parameters.bones);
+		for (int bone = 0; bone < bone_count; bone++)
+		{
+			auto child = bone * 2 + 1;
+			auto sibling = bone % 2 ? bone + 1 : -1;
+			Append(buffer, dxg::BoneLink{
+				static_cast<int8_t>(bone),
+				static_cast<int8_t>(GetParentBone(bone)),
+				static_cast<int8_t>(child < bone_count ? child : -1),
+				static_cast<int8_t>(sibling < bone_count ? sibling : -1)
+				});
+		}
+
+		// world -> bone, bones are only translated in the bind pose
+		std::vector<Vector3> world_positions(parameters.bones);
+		for (uint32_t bone = 0; bone < parameters.bones; bone++)
+		{
+			auto offset = GetBoneOffset(bone);
+			auto parent = GetParentBone(bone);
+			auto& position = world_positions[bone];
+			position = offset;
+			if (parent != -1)
+			{
+				position = { world_positions[parent].x + offset.x, world_positions[parent].y + offset.y, world_positions[parent].z + offset.z };
+			}
+
+			Matrix4x4 matrix;
+			matrix.m[0][0] = matrix.m[1][1] = matrix.m[2][2] = matrix.m[3][3] = 1.f;
+			matrix.m[3][0] = -position.x;
+			matrix.m[3][1] = -position.y;
+			matrix.m[3][2] = -position.z;
+			Append(buffer, matrix);
+		}
+
+		Patch(buffer, header_offset + offsetof(dxg::SkeletonHeader, data_size),
+			static_cast<uint32_t>(buffer.size() - header_offset - sizeof(dxg::SkeletonHeader)));
+	}
+
+	// one AnimationHeader with its blocks. Every bone gets its own translation and rotation for every key
+	// until the pools are full, scales are constant per bone so key reduction has something to drop.
+	void AppendAnimation(std::vector<uint8_t>& buffer, const fixtures::Parameters& parameters, uint32_t clip_index)
+	{
+		using namespace magic_enum::bitwise_operators;
+
+		auto keyframes = parameters.keyframes;
+		auto pool_size = std::min(parameters.bones * keyframes, MAX_KEY_POOL_SIZE);
+
+		mrb::AnimationHeader header{};
+		std::format("clip_{}", clip_index).copy(header.name, sizeof(header.name) - 1);
+		header.data_bitfield =
+			mrb::EAnimationDataType::Bones | mrb::EAnimationDataType::Keyframes |
+			mrb::EAnimationDataType::Unk2 | mrb::EAnimationDataType::Unk3 | mrb::EAnimationDataType::Unk4 |
+			mrb::EAnimationDataType::Positions | mrb::EAnimationDataType::Rotations |
+			mrb::EAnimationDataType::Scales | mrb::EAnimationDataType::IndexMap;
+		Append(buffer, header);
+
+		// blocks in bit order, the order GetDataBlock walks them in
+		auto bone_names = JoinNames(GetBoneNames(parameters.bones));
+		AppendDataBlock(buffer, static_cast<uint32_t>(bone_names.size()), 1, bone_names.data());
+
+		std::vector<uint32_t> times(keyframes);
+		for (uint32_t key = 0; key < keyframes; key++)
+		{
+			times[key] = key * KEYFRAME_INTERVAL_MS;
+		}
+		AppendDataBlock<uint32_t>(buffer, times);
+
+		// layouts of Unk2 and Unk3 are unknown, opaque bytes of odd sizes so the padding after them is exercised
+		constexpr uint8_t unk2[3] = {};
+		constexpr uint8_t unk3[2] = {};
+		AppendDataBlock(buffer, 3, 1, unk2);
+		AppendDataBlock(buffer, 1, 2, unk3);
+		uint32_t duration = keyframes ? (keyframes - 1) * KEYFRAME_INTERVAL_MS : 0;
+		AppendDataBlock(buffer, 1, sizeof(duration), &duration);
+
+		// pool entry i is key i % keyframes of bone i / keyframes
+		std::vector<Vector3> positions(pool_size);
+		std::vector<Vector4> rotations(pool_size);
+		for (uint32_t i = 0; i < pool_size; i++)
+		{
+			auto bone = i / keyframes;
+			auto phase = (i % keyframes) * 0.1f + bone + clip_index;
+			auto offset = GetBoneOffset(bone);
+			positions[i] = { offset.x, offset.y + 0.05f * std::sin(phase), offset.z };
+
+			// about an axis that differs per bone
+			auto half_angle = 0.25f * std::sin(phase);
+			auto axis_angle = bone * 0.7f;
+			auto sine = std::sin(half_angle);
+			rotations[i] = { std::cos(axis_angle) * sine, std::sin(axis_angle) * sine, 0.f, std::cos(half_angle) };
+		}
+		AppendDataBlock<Vector3>(buffer, positions);
+		AppendDataBlock<Vector4>(buffer, rotations);
+
+		std::vector<Vector3> scales(parameters.bones, Vector3{ 1.f, 1.f, 1.f });
+		AppendDataBlock<Vector3>(buffer, scales);
+
+		std::vector<mrb::IndexMapElement> index_map(size_t(parameters.bones) * keyframes);
+		for (uint32_t bone = 0; bone < parameters.bones; bone++)
+		{
+			for (uint32_t key = 0; key < keyframes; key++)
+			{
+				auto index = static_cast<uint16_t>((bone * keyframes + key) % pool_size);
+				index_map[size_t(bone) * keyframes + key] = { index, index, static_cast<uint16_t>(bone) };
+			}
+		}
+		AppendDataBlock(buffer, parameters.bones, static_cast<uint32_t>(sizeof(mrb::IndexMapElement) * keyframes), index_map.data());
+
+		Patch(buffer, offsetof(mrb::AnimationHeader, data_size), CheckDataSize(buffer.size(), "Animation"));
+	}
+
+	std::ofstream OpenOutput(const std::filesystem::path& path)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		if (!stream)
+		{
+			throw std::logic_error(std::format("Failed to open '{}'\n", path.string()));
+		}
+		return stream;
+	}
+
+	void CloseOutput(std::ofstream& stream, const std::filesystem::path& path)
+	{
+		stream.close();
+		if (!stream)
+		{
+			throw std::logic_error(std::format("Failed to write '{}'\n", path.string()));
+		}
+	}
+}
+
+namespace fixtures
+{
+	Parameters ParseParameters(std::string_view text)
+	{
+		Parameters parameters;
+		while (!text.empty())
+		{
+			auto end = text.find(',');
+			auto pair = text.substr(0, end);
+			text = end == text.npos ? std::string_view() : text.substr(end + 1);
+			if (pair.empty())
+			{
+				continue;
+			}
+
+			auto separator = pair.find('=');
+			auto name = pair.substr(0, separator);
+			auto value_text = separator == pair.npos ? std::string_view() : pair.substr(separator + 1);
+
+			uint32_t value;
+			auto [ptr, error] = std::from_chars(value_text.data(), value_text.data() + value_text.size(), value);
+			if (error != std::errc() || ptr != value_text.data() + value_text.size())
+			{
+				throw std::invalid_argument(std::format("Expected a number for fixture parameter '{}', got '{}'\n", name, value_text));
+			}
+
+			if (auto field = std::ranges::find(FIELDS, name, &Field::name); field != std::end(FIELDS))
+			{
+				parameters.*field->value = value;
+			}
+			else if (auto flag = std::ranges::find(SWITCHES, name, &Switch::name); flag != std::end(SWITCHES))
+			{
+				parameters.*flag->value = value != 0;
+			}
+			else
+			{
+				throw std::invalid_argument(std::format("Unknown fixture parameter '{}'\n", name));
+			}
+		}
+		return parameters;
+	}
+
+	void WriteDxg(const std::filesystem::path& path, const Parameters& parameters)
+	{
+		using namespace magic_enum::bitwise_operators;
+
+		Validate(parameters);
+
+		std::mt19937 random(parameters.seed);
+		auto stream = OpenOutput(path);
+		std::vector<uint8_t> buffer;
+
+		dxg::FileHeader file_header{};
+		std::memcpy(file_header.signature, "DXG", 4);
+		// 1.3, anything below 1.2 isn't supported
+		file_header.flag_a1 = 1;
+		file_header.flag_a2 = 3;
+		file_header.present_headers_map = dxg::FileHeader::EHeaders::MeshGroupListHeader | dxg::FileHeader::EHeaders::SkeletonHeader;
+		Append(buffer, file_header);
+
+		Append(buffer, dxg::MeshGroupListHeader{ parameters.groups, 0 });
+		std::vector<std::string> group_names;
+		for (uint32_t group = 0; group < parameters.groups; group++)
+		{
+			group_names.push_back(std::format("group_{}", group));
+		}
+		AppendStringList(buffer, group_names);
+		WriteBuffer(stream, buffer);
+
+		uint64_t list_size = buffer.size() - sizeof(dxg::FileHeader) - sizeof(dxg::MeshGroupListHeader);
+		for (uint32_t group = 0; group < parameters.groups; group++)
+		{
+			auto group_offset = static_cast<std::streamoff>(stream.tellp());
+			buffer.clear();
+			Append(buffer, dxg::MeshGroupHeader{ parameters.blocks, 0 });
+			WriteBuffer(stream, buffer);
+
+			uint64_t group_size = 0;
+			for (uint32_t block = 0; block < parameters.blocks; block++)
+			{
+				buffer.clear();
+				AppendMeshGroupData(buffer, parameters, group * parameters.blocks + block, random);
+				Patch(buffer, offsetof(dxg::MeshGroupDataHeader, data_size),
+					CheckDataSize(buffer.size() - sizeof(dxg::MeshGroupDataHeader), "Mesh group block"));
+				WriteBuffer(stream, buffer);
+				group_size += buffer.size();
+			}
+
+			PatchStream(stream, group_offset + offsetof(dxg::MeshGroupHeader, data_size), CheckDataSize(group_size, "Mesh group"));
+			list_size += sizeof(dxg::MeshGroupHeader) + group_size;
+		}
+		PatchStream(stream, sizeof(dxg::FileHeader) + offsetof(dxg::MeshGroupListHeader, data_size), CheckDataSize(list_size, "Mesh group list"));
+
+		buffer.clear();
+		AppendSkeleton(buffer, parameters);
+		WriteBuffer(stream, buffer);
+
+		CloseOutput(stream, path);
+	}
+
+	void WriteMrb(const std::filesystem::path& path, const Parameters& parameters)
+	{
+		Validate(parameters);
+
+		auto stream = OpenOutput(path);
+		std::vector<uint8_t> buffer;
+
+		mrb::FileHeader file_header{};
+		std::memcpy(file_header.signature, "MRB", 4);
+		file_header.magic = 9;
+		file_header.animation_count = parameters.clips;
+		Append(buffer, file_header);
+		WriteBuffer(stream, buffer);
+
+		for (uint32_t clip = 0; clip < parameters.clips; clip++)
+		{
+			buffer.clear();
+			AppendAnimation(buffer, parameters, clip);
+			WriteBuffer(stream, buffer);
+		}
+
+		CloseOutput(stream, path);
+	}
+}
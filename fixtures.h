@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <filesystem>
+
+// Synthetic DXG/MRB files for scaling tests and benchmarks. Output only depends on the parameters,
+// the same seed gives the same bytes. Files are streamed to disk a mesh group data block at a time,
+// so GB sized inputs don't need GB of memory.
+namespace fixtures
+{
+	struct Parameters
+	{
+		// DXG
+		uint32_t groups = 4;
+		// MeshGroupDataHeader blocks per group
+		uint32_t blocks = 2;
+		// meshes per block, up to 127
+		uint32_t meshes = 4;
+		// per mesh, up to 65535. A block shares one attribute pool of up to 32767 entries between its meshes.
+		uint32_t vertices = 1000;
+		// per mesh, up to 65535
+		uint32_t faces = 1500;
+		// skeleton bones, up to 127, animated by every clip
+		uint32_t bones = 32;
+		// weighted bones per mesh, up to 8, 0 for unskinned meshes
+		uint32_t weight_bones = 4;
+		bool uvs_2 = true;
+		bool colors = true;
+
+		// MRB
+		uint32_t clips = 4;
+		// per clip
+		uint32_t keyframes = 60;
+
+		uint32_t seed = 1;
+	};
+
+	// 'name=value' pairs separated with ',' over the defaults, e.g. "groups=64,vertices=20000,keyframes=300".
+	// Throws std::invalid_argument for unknown names and malformed values.
+	Parameters ParseParameters(std::string_view text);
+
+	// Mesh group list with every attribute stream, skinned meshes and a skeleton.
+	// Throws std::invalid_argument if the parameters don't fit the format, std::logic_error if the file can't be written.
+	void WriteDxg(const std::filesystem::path& path, const Parameters& parameters);
+
+	// Clips animating the DXG skeleton, every EAnimationDataType block present and 4 byte aligned
+	void WriteMrb(const std::filesystem::path& path, const Parameters& parameters);
+}
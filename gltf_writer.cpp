@@ -0,0 +1,431 @@
+#include "gltf_writer.h"
+
+#include <deque>
+#include <limits>
+#include <algorithm>
+#include <format>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+
+#include "json.h"
+
+namespace
+{
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;
+	constexpr uint32_t GLB_VERSION = 2;
+	constexpr uint32_t CHUNK_TYPE_JSON = 0x4E4F534A;
+	constexpr uint32_t CHUNK_TYPE_BIN = 0x004E4942;
+
+	constexpr int COMPONENT_UNSIGNED_BYTE = 5121;
+	constexpr int COMPONENT_UNSIGNED_SHORT = 5123;
+	constexpr int COMPONENT_UNSIGNED_INT = 5125;
+	constexpr int COMPONENT_FLOAT = 5126;
+
+	constexpr int TARGET_ARRAY_BUFFER = 34962;
+	constexpr int TARGET_ELEMENT_ARRAY_BUFFER = 34963;
+
+	size_t Align4(size_t value)
+	{
+		return (value + 3) & ~size_t(3);
+	}
+
+	std::string FormatFloats(const float* values, size_t count)
+	{
+		std::string result = "[";
+		for (size_t i = 0; i < count; i++)
+		{
+			if (i)
+			{
+				result += ',';
+			}
+			result += std::format("{}", values[i]);
+		}
+		result += ']';
+		return result;
+	}
+
+	// "key":[a,b,...] or nothing for an empty list, glTF doesn't allow empty arrays
+	template<class T>
+	std::string FormatList(std::string_view key, const std::vector<T>& items)
+	{
+		if (items.empty())
+		{
+			return {};
+		}
+
+		std::string result = std::format(R"(,"{}":[)", key);
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			if (i)
+			{
+				result += ',';
+			}
+			result += std::format("{}", items[i]);
+		}
+		result += ']';
+		return result;
+	}
+
+	// Collects the JSON objects and the layout of the BIN chunk. Views only point at their data,
+	// nothing is copied until Write streams every view into the file.
+	class GlbBuilder
+	{
+	public:
+		// data must stay alive until Write
+		int AddView(const void* data, size_t size, int target)
+		{
+			_binary_size = Align4(_binary_size);
+			_buffer_views.push_back(std::format(R"({{"buffer":0,"byteOffset":{},"byteLength":{}{}}})",
+				_binary_size, size, target ? std::format(R"(,"target":{})", target) : std::string()));
+			_views.push_back({ static_cast<const char*>(data), size });
+			_binary_size += size;
+			return static_cast<int>(_views.size() - 1);
+		}
+
+		// extra is appended to the accessor object as is, e.g. min/max or normalized
+		int AddAccessor(const void* data, size_t size, size_t count, int component_type, std::string_view type, int target,
+			std::string_view extra = {})
+		{
+			auto view = AddView(data, size, target);
+			_accessors.push_back(std::format(R"({{"bufferView":{},"componentType":{},"count":{},"type":"{}"{}}})",
+				view, component_type, count, type, extra));
+			return static_cast<int>(_accessors.size() - 1);
+		}
+
+		template<class T>
+		int AddAccessor(std::span<const T> data, size_t count, int component_type, std::string_view type, int target,
+			std::string_view extra = {})
+		{
+			return AddAccessor(data.data(), data.size_bytes(), count, component_type, type, target, extra);
+		}
+
+		// storage for the few streams that have to be converted, stays put until Write
+		template<class T>
+		std::vector<T>& AddScratch(size_t count)
+		{
+			if constexpr (std::is_same_v<T, float>)
+			{
+				return _float_scratch.emplace_back(count);
+			}
+			else
+			{
+				static_assert(std::is_same_v<T, uint16_t>);
+				return _uint16_scratch.emplace_back(count);
+			}
+		}
+
+		std::string FormatAccessors() const
+		{
+			return FormatList("accessors", _accessors);
+		}
+
+		std::string FormatBuffers() const
+		{
+			if (_views.empty())
+			{
+				return {};
+			}
+			return std::format(R"(,"bufferViews":[{}],"buffers":[{{"byteLength":{}}}])", Join(_buffer_views), Align4(_binary_size));
+		}
+
+		void Write(const std::filesystem::path& path, std::string_view json) const
+		{
+			// GLB header and chunk lengths are 32 bit, checked before anything is written
+			uint64_t glb_size = 12 + 8 + Align4(json.size()) + (_binary_size ? 8 + Align4(_binary_size) : 0);
+			if (glb_size > std::numeric_limits<uint32_t>::max())
+			{
+				throw std::invalid_argument(std::format("'{}' would be {} bytes, GLB files are limited to 4 GB\n", path.string(), glb_size));
+			}
+
+			std::ofstream stream(path, std::ios::binary);
+			if (!stream)
+			{
+				throw std::logic_error(std::format("Failed to open '{}'\n", path.string()));
+			}
+
+			auto json_size = static_cast<uint32_t>(Align4(json.size()));
+			auto binary_size = static_cast<uint32_t>(Align4(_binary_size));
+			auto total_size = static_cast<uint32_t>(glb_size);
+
+			const uint32_t header[] = { GLB_MAGIC, GLB_VERSION, total_size, json_size, CHUNK_TYPE_JSON };
+			stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+			stream.write(json.data(), json.size());
+			stream.write("   ", json_size - json.size());
+
+			if (binary_size)
+			{
+				const uint32_t binary_header[] = { binary_size, CHUNK_TYPE_BIN };
+				stream.write(reinterpret_cast<const char*>(binary_header), sizeof(binary_header));
+
+				constexpr char zeros[4] = {};
+				size_t written = 0;
+				for (auto&& view : _views)
+				{
+					stream.write(zeros, Align4(written) - written);
+					stream.write(view.data, view.size);
+					written = Align4(written) + view.size;
+				}
+				stream.write(zeros, binary_size - written);
+			}
+
+			if (!stream)
+			{
+				throw std::logic_error(std::format("Failed to write '{}'\n", path.string()));
+			}
+		}
+
+	private:
+		struct View
+		{
+			const char* data;
+			size_t size;
+		};
+
+		static std::string Join(const std::vector<std::string>& items)
+		{
+			std::string result;
+			for (size_t i = 0; i < items.size(); i++)
+			{
+				if (i)
+				{
+					result += ',';
+				}
+				result += items[i];
+			}
+			return result;
+		}
+
+		std::vector<View> _views;
+		std::vector<std::string> _buffer_views;
+		std::vector<std::string> _accessors;
+		size_t _binary_size = 0;
+		std::deque<std::vector<float>> _float_scratch;
+		std::deque<std::vector<uint16_t>> _uint16_scratch;
+	};
+
+	// POSITION accessors must carry their bounds
+	std::string FormatBounds(std::span<const Vector3> positions)
+	{
+		Vector3 min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		Vector3 max = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+		for (auto&& position : positions)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				min.raw[i] = std::min(min.raw[i], position.raw[i]);
+				max.raw[i] = std::max(max.raw[i], position.raw[i]);
+			}
+		}
+		return std::format(R"(,"min":{},"max":{})", FormatFloats(min.raw, 3), FormatFloats(max.raw, 3));
+	}
+
+	// JOINTS_0/WEIGHTS_0 are vec4, the IR has 3 influences per vertex
+	void AddSkinAttributes(GlbBuilder& builder, const ir::MeshGroup& group, std::string& attributes)
+	{
+		auto vertex_count = group.GetVertexCount();
+		auto& joints = builder.AddScratch<uint16_t>(vertex_count * 4);
+		auto& weights = builder.AddScratch<float>(vertex_count * 4);
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				joints[i * 4 + j] = group.joints[i * 3 + j];
+				weights[i * 4 + j] = group.weights[i * 3 + j];
+			}
+
+			// unskinned meshes of a skinned group follow the group's first bone instead of collapsing
+			if (weights[i * 4 + 0] == 0.f && weights[i * 4 + 1] == 0.f && weights[i * 4 + 2] == 0.f)
+			{
+				joints[i * 4 + 0] = static_cast<uint16_t>(group.skin_bones.front());
+				weights[i * 4 + 0] = 1.f;
+			}
+		}
+
+		auto joints_accessor = builder.AddAccessor(std::span<const uint16_t>(joints), vertex_count, COMPONENT_UNSIGNED_SHORT, "VEC4", TARGET_ARRAY_BUFFER);
+		auto weights_accessor = builder.AddAccessor(std::span<const float>(weights), vertex_count, COMPONENT_FLOAT, "VEC4", TARGET_ARRAY_BUFFER);
+		attributes += std::format(R"(,"JOINTS_0":{},"WEIGHTS_0":{})", joints_accessor, weights_accessor);
+	}
+
+	// -1 if the group has nothing to draw
+	int AddMesh(GlbBuilder& builder, const ir::MeshGroup& group, bool skinned, std::vector<std::string>& meshes)
+	{
+		auto vertex_count = group.GetVertexCount();
+		if (!group.has_geometry || vertex_count == 0 || group.indices.empty())
+		{
+			return -1;
+		}
+
+		auto positions = builder.AddAccessor(std::span(group.positions), vertex_count, COMPONENT_FLOAT, "VEC3", TARGET_ARRAY_BUFFER,
+			FormatBounds(group.positions));
+		auto normals = builder.AddAccessor(std::span(group.normals), vertex_count, COMPONENT_FLOAT, "VEC3", TARGET_ARRAY_BUFFER);
+		// DXG and glTF both have v pointing down, no flip unlike FBX
+		auto uvs = builder.AddAccessor(std::span(group.uvs), vertex_count, COMPONENT_FLOAT, "VEC2", TARGET_ARRAY_BUFFER);
+
+		auto attributes = std::format(R"("POSITION":{},"NORMAL":{},"TEXCOORD_0":{})", positions, normals, uvs);
+		if (group.has_uvs_2)
+		{
+			auto uvs_2 = builder.AddAccessor(std::span(group.uvs_2), vertex_count, COMPONENT_FLOAT, "VEC2", TARGET_ARRAY_BUFFER);
+			attributes += std::format(R"(,"TEXCOORD_1":{})", uvs_2);
+		}
+		if (group.has_colors)
+		{
+			auto colors = builder.AddAccessor(std::span(group.colors), vertex_count, COMPONENT_UNSIGNED_BYTE, "VEC4", TARGET_ARRAY_BUFFER,
+				R"(,"normalized":true)");
+			attributes += std::format(R"(,"COLOR_0":{})", colors);
+		}
+		if (skinned)
+		{
+			AddSkinAttributes(builder, group, attributes);
+		}
+
+		auto indices = builder.AddAccessor(std::span(group.indices), group.indices.size(), COMPONENT_UNSIGNED_INT, "SCALAR",
+			TARGET_ELEMENT_ARRAY_BUFFER);
+
+		meshes.push_back(std::format(R"({{"name":"{}","primitives":[{{"attributes":{{{}}},"indices":{},"mode":4}}]}})",
+			EscapeJson(group.name), attributes, indices));
+		return static_cast<int>(meshes.size() - 1);
+	}
+
+	// one sampler per track and path, the clip key times are shared by every channel keeping all of its keys
+	void AddAnimation(GlbBuilder& builder, const ir::AnimationClip& clip, int first_bone_node, std::vector<std::string>& animations)
+	{
+		if (clip.key_times.empty() || clip.tracks.empty())
+		{
+			return;
+		}
+
+		auto add_input = [&](std::span<const uint32_t> key_times)
+		{
+			auto& times = builder.AddScratch<float>(key_times.size());
+			for (size_t i = 0; i < key_times.size(); i++)
+			{
+				times[i] = static_cast<float>(key_times[i]) / 1000.f;
+			}
+			return builder.AddAccessor(std::span<const float>(times), times.size(), COMPONENT_FLOAT, "SCALAR", 0,
+				std::format(R"(,"min":[{}],"max":[{}])", times.front(), times.back()));
+		};
+		auto clip_input = add_input(clip.key_times);
+
+		// reduced channels get the times of their kept keys
+		std::vector<uint32_t> channel_times;
+		auto channel_input = [&](std::span<const uint32_t> keys)
+		{
+			if (keys.empty())
+			{
+				return clip_input;
+			}
+			channel_times.resize(keys.size());
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				channel_times[i] = clip.key_times[keys[i]];
+			}
+			return add_input(channel_times);
+		};
+
+		std::vector<std::string> samplers;
+		std::vector<std::string> channels;
+		auto add_channel = [&](int node, std::string_view path, int input, int output)
+		{
+			channels.push_back(std::format(R"({{"sampler":{},"target":{{"node":{},"path":"{}"}}}})", samplers.size(), node, path));
+			samplers.push_back(std::format(R"({{"input":{},"output":{},"interpolation":"LINEAR"}})", input, output));
+		};
+
+		for (auto&& track : clip.tracks)
+		{
+			auto node = first_bone_node + track.bone;
+			add_channel(node, "translation", channel_input(track.translation_keys),
+				builder.AddAccessor(std::span(track.translations), track.translations.size(), COMPONENT_FLOAT, "VEC3", 0));
+			// MRB quaternions are (x, y, z, w) like glTF, no euler round trip
+			add_channel(node, "rotation", channel_input(track.rotation_keys),
+				builder.AddAccessor(std::span(track.rotations), track.rotations.size(), COMPONENT_FLOAT, "VEC4", 0));
+			add_channel(node, "scale", channel_input(track.scale_keys),
+				builder.AddAccessor(std::span(track.scales), track.scales.size(), COMPONENT_FLOAT, "VEC3", 0));
+		}
+
+		std::string samplers_json;
+		std::string channels_json;
+		for (size_t i = 0; i < samplers.size(); i++)
+		{
+			samplers_json += (i ? "," : "") + samplers[i];
+			channels_json += (i ? "," : "") + channels[i];
+		}
+		animations.push_back(std::format(R"({{"name":"{}","samplers":[{}],"channels":[{}]}})",
+			EscapeJson(clip.name), samplers_json, channels_json));
+	}
+}
+
+namespace gltf
+{
+	void WriteGlb(const std::filesystem::path& path, const Skeleton& skeleton, std::span<const ir::MeshGroup> mesh_groups,
+		std::span<const ir::AnimationClip> clips)
+	{
+		GlbBuilder builder;
+
+		// node 0 is "Root" like in the FBX output, bones follow in topological order, then one node per mesh group
+		constexpr int first_bone_node = 1;
+		auto bone_count = static_cast<int>(skeleton.GetBoneCount());
+
+		std::vector<int> root_children;
+		std::vector<std::vector<int>> bone_children(bone_count);
+		for (int bone = 0; bone < bone_count; bone++)
+		{
+			auto parent = skeleton.parents[bone];
+			(parent == -1 ? root_children : bone_children[parent]).push_back(first_bone_node + bone);
+		}
+
+		std::vector<std::string> skins;
+		if (bone_count)
+		{
+			// DXG matrices are row vector row-major, the same bytes as glTF's column vector column-major
+			auto inverse_bind_matrices = builder.AddAccessor(std::span(skeleton.inverse_bind_matrices), bone_count, COMPONENT_FLOAT, "MAT4", 0);
+			std::vector<int> joints(bone_count);
+			for (int bone = 0; bone < bone_count; bone++)
+			{
+				joints[bone] = first_bone_node + bone;
+			}
+			skins.push_back(std::format(R"({{"inverseBindMatrices":{}{}}})", inverse_bind_matrices, FormatList("joints", joints)));
+		}
+
+		// root node is formatted last, its children include the group nodes
+		std::vector<std::string> nodes(1);
+		for (int bone = 0; bone < bone_count; bone++)
+		{
+			nodes.push_back(std::format(R"({{"name":"{}","translation":{},"rotation":{},"scale":{}{}}})",
+				EscapeJson(skeleton.names[bone]),
+				FormatFloats(skeleton.local_translations[bone].raw, 3),
+				FormatFloats(skeleton.local_quaternions[bone].raw, 4),
+				FormatFloats(skeleton.local_scales[bone].raw, 3),
+				FormatList("children", bone_children[bone])));
+		}
+
+		std::vector<std::string> meshes;
+		for (auto&& group : mesh_groups)
+		{
+			auto skinned = bone_count && !group.skin_bones.empty();
+			auto mesh = AddMesh(builder, group, skinned, meshes);
+			root_children.push_back(static_cast<int>(nodes.size()));
+			if (mesh == -1)
+			{
+				nodes.push_back(std::format(R"({{"name":"{}"}})", EscapeJson(group.name)));
+			}
+			else
+			{
+				nodes.push_back(std::format(R"({{"name":"{}","mesh":{}{}}})", EscapeJson(group.name), mesh, skinned ? R"(,"skin":0)" : ""));
+			}
+		}
+		nodes[0] = std::format(R"({{"name":"Root"{}}})", FormatList("children", root_children));
+
+		std::vector<std::string> animations;
+		for (auto&& clip : clips)
+		{
+			AddAnimation(builder, clip, first_bone_node, animations);
+		}
+
+		auto json = std::format(R"({{"asset":{{"version":"2.0","generator":"DXGPareser"}},"scene":0,"scenes":[{{"nodes":[0]}}]{}{}{}{}{}{}}})",
+			FormatList("nodes", nodes), FormatList("meshes", meshes), FormatList("skins", skins), FormatList("animations", animations),
+			builder.FormatAccessors(), builder.FormatBuffers());
+
+		builder.Write(path, json);
+	}
+}
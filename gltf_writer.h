@@ -0,0 +1,16 @@
+#pragma once
+#include <span>
+#include <filesystem>
+
+#include "scene_ir.h"
+
+// Binary glTF 2.0 output straight from the IR, no FBX SDK involved.
+// Vertex streams, indices, inverse bind matrices and animation samples are written from the IR
+// arrays into the BIN chunk as they are, only joints, weights and key times are widened/converted.
+namespace gltf
+{
+	// Skeleton, mesh groups and clips as one .glb file, throws std::logic_error if the file can't be written
+	// and std::invalid_argument if the scene doesn't fit the 4 GB the format's 32 bit lengths allow
+	void WriteGlb(const std::filesystem::path& path, const Skeleton& skeleton, std::span<const ir::MeshGroup> mesh_groups,
+		std::span<const ir::AnimationClip> clips);
+}
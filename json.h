@@ -0,0 +1,28 @@
+#pragma once
+#include <format>
+#include <string>
+#include <string_view>
+
+// Text as the content of a JSON string literal
+inline std::string EscapeJson(std::string_view text)
+{
+	std::string result;
+	result.reserve(text.size());
+	for (auto c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			result += std::format("\\u{:04x}", static_cast<int>(c));
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,412 @@
+#pragma once
+#include <span>
+#include <cmath>
+#include <array>
+#include <cstdint>
+#include <numbers>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DXG_KERNELS_SSE2 1
+#endif
+
+// Batch kernels for the hot conversion loops. SSE2 is the x64 baseline,
+// every kernel has a scalar tail/fallback for the remaining elements.
+namespace kernels
+{
+	namespace detail
+	{
+#ifdef DXG_KERNELS_SSE2
+		// stores lanes of a/b/c as 4 interleaved (a, b, c) triples, 12 floats
+		inline void StoreInterleaved3(__m128 a, __m128 b, __m128 c, float* destination)
+		{
+			auto ab_low = _mm_unpacklo_ps(a, b);
+			auto ab_high = _mm_unpackhi_ps(a, b);
+			auto ca_low = _mm_unpacklo_ps(c, a);
+			auto ca_high = _mm_unpackhi_ps(c, a);
+			auto bc_low = _mm_unpacklo_ps(b, c);
+			auto bc_high = _mm_unpackhi_ps(b, c);
+
+			_mm_storeu_ps(destination, _mm_shuffle_ps(ab_low, ca_low, _MM_SHUFFLE(3, 0, 1, 0)));
+			_mm_storeu_ps(destination + 4, _mm_shuffle_ps(bc_low, ab_high, _MM_SHUFFLE(1, 0, 3, 2)));
+			_mm_storeu_ps(destination + 8, _mm_shuffle_ps(ca_high, bc_high, _MM_SHUFFLE(3, 2, 3, 0)));
+		}
+#endif
+	}
+
+	// destination[i] = source[vertices[i].*index], one attribute stream of a mesh through its per vertex index records
+	template<class T, class Source, class Vertex, class Index>
+	inline void GatherVertexAttribute(T* destination, std::span<const Source> source, std::span<const Vertex> vertices, Index Vertex::* index)
+	{
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			destination[i] = source[vertices[i].*index];
+		}
+	}
+
+	// destination[i] = base + source[i], zero-extending u16 to u32
+	inline void RebaseIndices(std::span<const uint16_t> source, uint32_t base, uint32_t* destination)
+	{
+		size_t i = 0;
+#ifdef DXG_KERNELS_SSE2
+		const auto zero = _mm_setzero_si128();
+		const auto base_vector = _mm_set1_epi32(static_cast<int32_t>(base));
+		for (; i + 8 <= source.size(); i += 8)
+		{
+			auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data() + i));
+			auto low = _mm_add_epi32(_mm_unpacklo_epi16(packed, zero), base_vector);
+			auto high = _mm_add_epi32(_mm_unpackhi_epi16(packed, zero), base_vector);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), low);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 4), high);
+		}
+#endif
+		for (; i < source.size(); i++)
+		{
+			destination[i] = base + source[i];
+		}
+	}
+
+	// Expands packed (w0, w1) pairs to (w0, w1, 1 - w0 - w1) triples.
+	// source holds 2 floats per vertex, destination receives 3 floats per vertex.
+	inline void ExpandBoneWeights(const float* source, size_t vertex_count, float* destination)
+	{
+		size_t i = 0;
+#ifdef DXG_KERNELS_SSE2
+		const auto one = _mm_set1_ps(1.f);
+		for (; i + 4 <= vertex_count; i += 4)
+		{
+			auto pairs_low = _mm_loadu_ps(source + i * 2);
+			auto pairs_high = _mm_loadu_ps(source + i * 2 + 4);
+			auto a = _mm_shuffle_ps(pairs_low, pairs_high, _MM_SHUFFLE(2, 0, 2, 0));
+			auto b = _mm_shuffle_ps(pairs_low, pairs_high, _MM_SHUFFLE(3, 1, 3, 1));
+			auto c = _mm_sub_ps(_mm_sub_ps(one, a), b);
+			detail::StoreInterleaved3(a, b, c, destination + i * 3);
+		}
+#endif
+		for (; i < vertex_count; i++)
+		{
+			destination[i * 3 + 0] = source[i * 2 + 0];
+			destination[i * 3 + 1] = source[i * 2 + 1];
+			destination[i * 3 + 2] = 1.f - source[i * 2 + 0] - source[i * 2 + 1];
+		}
+	}
+
+	// Skeleton bone of each of the 3 influences per vertex, bone_indices index into bones.
+	// Joints of zero weights are left as they are, their indices may be garbage.
+	inline void ResolveJoints(const float* weights, const int8_t* bone_indices, std::span<const int> bones, size_t vertex_count, uint16_t* joints)
+	{
+		for (size_t i = 0; i < vertex_count * 3; i++)
+		{
+			if (weights[i] != 0.f)
+			{
+				joints[i] = static_cast<uint16_t>(bones[bone_indices[i]]);
+			}
+		}
+	}
+
+	// 4x4 matrices in structure of arrays layout: element e (row-major) of matrix i is streams[e][i]
+	using MatrixStreams = std::array<float*, 16>;
+	using ConstMatrixStreams = std::array<const float*, 16>;
+
+	namespace detail
+	{
+#ifdef DXG_KERNELS_SSE2
+		// four matrices at once, one per lane
+		struct Lanes
+		{
+			__m128 v;
+
+			static Lanes Load(const float* source) { return { _mm_loadu_ps(source) }; }
+			void Store(float* destination) const { _mm_storeu_ps(destination, v); }
+
+			friend Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+			friend Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+			friend Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+			friend Lanes operator-(Lanes a) { return { _mm_sub_ps(_mm_setzero_ps(), a.v) }; }
+			friend Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+
+			static Lanes Set(float value) { return { _mm_set1_ps(value) }; }
+
+			// comparisons give all-ones/all-zeros lane masks
+			friend Lanes operator<(Lanes a, Lanes b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+			friend Lanes operator==(Lanes a, Lanes b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+			friend Lanes Select(Lanes mask, Lanes a, Lanes b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+			friend Lanes Abs(Lanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.f), a.v) }; }
+			friend Lanes Sqrt(Lanes a) { return { _mm_sqrt_ps(a.v) }; }
+			friend Lanes Min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+			friend Lanes Max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+
+			// 1 / a, or 0 for singular lanes
+			friend Lanes SafeReciprocal(Lanes a)
+			{
+				auto nonzero = _mm_cmpneq_ps(a.v, _mm_setzero_ps());
+				return { _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.f), a.v), nonzero) };
+			}
+		};
+		constexpr size_t LANE_WIDTH = 4;
+#endif
+
+		struct Scalar
+		{
+			float v;
+
+			static Scalar Load(const float* source) { return { *source }; }
+			void Store(float* destination) const { *destination = v; }
+
+			friend Scalar operator+(Scalar a, Scalar b) { return { a.v + b.v }; }
+			friend Scalar operator-(Scalar a, Scalar b) { return { a.v - b.v }; }
+			friend Scalar operator*(Scalar a, Scalar b) { return { a.v * b.v }; }
+			friend Scalar operator-(Scalar a) { return { -a.v }; }
+			friend Scalar operator/(Scalar a, Scalar b) { return { a.v / b.v }; }
+			friend Scalar SafeReciprocal(Scalar a) { return { a.v != 0.f ? 1.f / a.v : 0.f }; }
+
+			static Scalar Set(float value) { return { value }; }
+
+			friend bool operator<(Scalar a, Scalar b) { return a.v < b.v; }
+			friend bool operator==(Scalar a, Scalar b) { return a.v == b.v; }
+			friend Scalar Select(bool mask, Scalar a, Scalar b) { return mask ? a : b; }
+			friend Scalar Abs(Scalar a) { return { std::fabs(a.v) }; }
+			friend Scalar Sqrt(Scalar a) { return { std::sqrt(a.v) }; }
+			friend Scalar Min(Scalar a, Scalar b) { return { a.v < b.v ? a.v : b.v }; }
+			friend Scalar Max(Scalar a, Scalar b) { return { a.v > b.v ? a.v : b.v }; }
+		};
+
+		// cofactor expansion, works for either element order since inverse(transpose(m)) == transpose(inverse(m))
+		template<class L>
+		void InvertMatrix(ConstMatrixStreams source, MatrixStreams destination, size_t i)
+		{
+			L m[16];
+			for (int e = 0; e < 16; e++)
+			{
+				m[e] = L::Load(source[e] + i);
+			}
+
+			L inv[16];
+			inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+			inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+			inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+			inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+			inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+			inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+			inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+			inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+			inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+			inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+			inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+			inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+			inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+			inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+			inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+			inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+			auto inv_det = SafeReciprocal(m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12]);
+			for (int e = 0; e < 16; e++)
+			{
+				(inv[e] * inv_det).Store(destination[e] + i);
+			}
+		}
+
+		// destination = a * b, row-major element order
+		template<class L>
+		void MultiplyMatrix(ConstMatrixStreams a, ConstMatrixStreams b, MatrixStreams destination, size_t i)
+		{
+			L lhs[16];
+			L rhs[16];
+			for (int e = 0; e < 16; e++)
+			{
+				lhs[e] = L::Load(a[e] + i);
+				rhs[e] = L::Load(b[e] + i);
+			}
+
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					auto value = lhs[row * 4 + 0] * rhs[0 * 4 + column] +
+						lhs[row * 4 + 1] * rhs[1 * 4 + column] +
+						lhs[row * 4 + 2] * rhs[2 * 4 + column] +
+						lhs[row * 4 + 3] * rhs[3 * 4 + column];
+					value.Store(destination[row * 4 + column] + i);
+				}
+			}
+		}
+
+		// Cephes atanf: range reduction to |x| <= tan(pi/8) and a degree 9 odd polynomial, ~2 ulp
+		template<class L>
+		L Atan(L x)
+		{
+			auto a = Abs(x);
+			auto large = L::Set(2.414213562373095f) < a;
+			auto medium = L::Set(0.4142135623730950f) < a;
+			auto one = L::Set(1.f);
+			auto reduced = Select(large, -one / a, Select(medium, (a - one) / (a + one), a));
+			auto offset = Select(large, L::Set(std::numbers::pi_v<float> / 2.f), Select(medium, L::Set(std::numbers::pi_v<float> / 4.f), L::Set(0.f)));
+
+			auto z = reduced * reduced;
+			auto polynomial = (((L::Set(8.05374449538e-2f) * z - L::Set(1.38776856032e-1f)) * z + L::Set(1.99777106478e-1f)) * z - L::Set(3.33329491539e-1f)) * z * reduced + reduced;
+			auto result = offset + polynomial;
+			return Select(x < L::Set(0.f), -result, result);
+		}
+
+		template<class L>
+		L Atan2(L y, L x)
+		{
+			auto zero = L::Set(0.f);
+			auto pi = L::Set(std::numbers::pi_v<float>);
+			auto y_negative = y < zero;
+			auto result = Atan(y / x) + Select(x < zero, Select(y_negative, -pi, pi), zero);
+
+			auto half_pi = L::Set(std::numbers::pi_v<float> / 2.f);
+			auto on_y_axis = Select(y_negative, -half_pi, Select(zero < y, half_pi, zero));
+			return Select(x == zero, on_y_axis, result);
+		}
+
+		// XYZ euler angles in degrees of a (x, y, z, w) quaternion, same decomposition as FbxAMatrix::GetR
+		template<class L>
+		void QuaternionToEuler(L x, L y, L z, L w, L& euler_x, L& euler_y, L& euler_z)
+		{
+			auto inv_length = SafeReciprocal(Sqrt(x * x + y * y + z * z + w * w));
+			x = x * inv_length;
+			y = y * inv_length;
+			z = z * inv_length;
+			w = w * inv_length;
+
+			// rows of the rotation matrix (rotated basis vectors)
+			auto one = L::Set(1.f);
+			auto two = L::Set(2.f);
+			auto r00 = one - two * (y * y + z * z);
+			auto r01 = two * (x * y + z * w);
+			auto r02 = two * (x * z - y * w);
+			auto r11 = one - two * (x * x + z * z);
+			auto r12 = two * (y * z + x * w);
+			auto r21 = two * (y * z - x * w);
+			auto r22 = one - two * (x * x + y * y);
+
+			auto sin_y = Max(-one, Min(one, -r02));
+			// from the first row rather than sqrt(1 - sin_y^2), which loses precision near +-90 degrees
+			auto cos_y = Sqrt(r00 * r00 + r01 * r01);
+			// gimbal lock folds z into x
+			auto regular = Abs(sin_y) < L::Set(0.99999f);
+
+			auto to_degrees = L::Set(180.f / std::numbers::pi_v<float>);
+			euler_x = Select(regular, Atan2(r12, r22), Atan2(-r21, r11)) * to_degrees;
+			euler_y = Atan2(sin_y, cos_y) * to_degrees;
+			euler_z = Select(regular, Atan2(r01, r00), L::Set(0.f)) * to_degrees;
+		}
+	}
+
+	// destination[i] = inverse(source[i]), singular matrices come out as zero
+	inline void InvertMatrices(ConstMatrixStreams source, MatrixStreams destination, size_t count)
+	{
+		size_t i = 0;
+#ifdef DXG_KERNELS_SSE2
+		for (; i + detail::LANE_WIDTH <= count; i += detail::LANE_WIDTH)
+		{
+			detail::InvertMatrix<detail::Lanes>(source, destination, i);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			detail::InvertMatrix<detail::Scalar>(source, destination, i);
+		}
+	}
+
+	// destination[i] = a[i] * b[i]
+	inline void MultiplyMatrices(ConstMatrixStreams a, ConstMatrixStreams b, MatrixStreams destination, size_t count)
+	{
+		size_t i = 0;
+#ifdef DXG_KERNELS_SSE2
+		for (; i + detail::LANE_WIDTH <= count; i += detail::LANE_WIDTH)
+		{
+			detail::MultiplyMatrix<detail::Lanes>(a, b, destination, i);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			detail::MultiplyMatrix<detail::Scalar>(a, b, destination, i);
+		}
+	}
+
+	// (x, y, z, w) quaternions -> XYZ euler angles in degrees, 4 floats in and 3 floats out per rotation.
+	// Matches FbxAMatrix::SetQ + GetR to float precision, SIMD lanes and the scalar tail give identical results.
+	inline void QuaternionsToEuler(const float* quaternions, size_t count, float* angles)
+	{
+		size_t i = 0;
+#ifdef DXG_KERNELS_SSE2
+		for (; i + detail::LANE_WIDTH <= count; i += detail::LANE_WIDTH)
+		{
+			auto x = _mm_loadu_ps(quaternions + i * 4);
+			auto y = _mm_loadu_ps(quaternions + i * 4 + 4);
+			auto z = _mm_loadu_ps(quaternions + i * 4 + 8);
+			auto w = _mm_loadu_ps(quaternions + i * 4 + 12);
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+
+			detail::Lanes euler_x, euler_y, euler_z;
+			detail::QuaternionToEuler(detail::Lanes{ x }, detail::Lanes{ y }, detail::Lanes{ z }, detail::Lanes{ w }, euler_x, euler_y, euler_z);
+			detail::StoreInterleaved3(euler_x.v, euler_y.v, euler_z.v, angles + i * 3);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			auto quaternion = quaternions + i * 4;
+			detail::Scalar euler_x, euler_y, euler_z;
+			detail::QuaternionToEuler(detail::Scalar{ quaternion[0] }, detail::Scalar{ quaternion[1] }, detail::Scalar{ quaternion[2] }, detail::Scalar{ quaternion[3] },
+				euler_x, euler_y, euler_z);
+			angles[i * 3 + 0] = euler_x.v;
+			angles[i * 3 + 1] = euler_y.v;
+			angles[i * 3 + 2] = euler_z.v;
+		}
+	}
+
+	// Flips quaternions (4 floats each) into the hemisphere of their predecessor, so interpolating
+	// consecutive keys takes the short path. q and -q are the same rotation, euler angles don't change.
+	inline void AlignQuaternionHemispheres(float* quaternions, size_t count)
+	{
+		for (size_t i = 1; i < count; i++)
+		{
+			auto previous = quaternions + (i - 1) * 4;
+			auto current = quaternions + i * 4;
+			auto dot = previous[0] * current[0] + previous[1] * current[1] + previous[2] * current[2] + previous[3] * current[3];
+			if (dot < 0.f)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					current[c] = -current[c];
+				}
+			}
+		}
+	}
+
+	// Makes a sequence of XYZ euler angle triples (degrees) continuous, like the SDK's euler filter.
+	// (x, y, z) and (x + 180, 180 - y, z + 180) are the same rotation, each key takes whichever is closer
+	// to the previous key once whole turns are added, so no component moves by more than 180 degrees.
+	inline void UnrollEulerAngles(float* angles, size_t count)
+	{
+		for (size_t i = 1; i < count; i++)
+		{
+			auto previous = angles + (i - 1) * 3;
+			auto current = angles + i * 3;
+			float candidates[2][3] = {
+				{ current[0], current[1], current[2] },
+				{ current[0] + 180.f, 180.f - current[1], current[2] + 180.f }
+			};
+			float distances[2] = {};
+			for (int candidate = 0; candidate < 2; candidate++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					auto& angle = candidates[candidate][c];
+					angle -= 360.f * std::round((angle - previous[c]) / 360.f);
+					distances[candidate] += std::abs(angle - previous[c]);
+				}
+			}
+
+			// ties keep the decomposition as it is
+			auto& closest = candidates[distances[1] < distances[0] ? 1 : 0];
+			for (int c = 0; c < 3; c++)
+			{
+				current[c] = closest[c];
+			}
+		}
+	}
+}
@@ -0,0 +1,170 @@
+#include "log.h"
+
+#include <array>
+#include <thread>
+#include <cstdint>
+#include <iostream>
+
+namespace
+{
+	// Bounded multi producer, single consumer ring (Vyukov). Every slot carries the position it is ready for,
+	// producers claim a position with one CAS, the writer thread owns stdout and never takes a lock.
+	class Writer
+	{
+	public:
+		Writer()
+		{
+			for (size_t i = 0; i < RING_SIZE; i++)
+			{
+				_slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			_thread = std::jthread([this](std::stop_token stop_token)
+			{
+				Run(stop_token);
+			});
+		}
+
+		// drains the ring before the thread goes away
+		~Writer()
+		{
+			_thread.request_stop();
+			Signal();
+		}
+
+		void Push(std::string text)
+		{
+			auto position = _enqueue_position.load(std::memory_order_relaxed);
+			Slot* slot;
+			for (;;)
+			{
+				slot = &_slots[position & (RING_SIZE - 1)];
+				auto sequence = slot->sequence.load(std::memory_order_acquire);
+				auto distance = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+				if (distance == 0)
+				{
+					if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else
+				{
+					// the slot is a ring behind, wait for the writer to free it
+					if (distance < 0)
+					{
+						std::this_thread::yield();
+					}
+					position = _enqueue_position.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->text = std::move(text);
+			slot->sequence.store(position + 1, std::memory_order_release);
+			Signal();
+		}
+
+		void Flush()
+		{
+			auto target = _enqueue_position.load(std::memory_order_relaxed);
+			for (auto written = _written.load(std::memory_order_acquire); written < target; written = _written.load(std::memory_order_acquire))
+			{
+				_written.wait(written, std::memory_order_acquire);
+			}
+		}
+
+	private:
+		static constexpr size_t RING_SIZE = 4096;
+
+		struct Slot
+		{
+			std::atomic<size_t> sequence;
+			std::string text;
+		};
+
+		void Signal()
+		{
+			_signal.fetch_add(1, std::memory_order_release);
+			_signal.notify_one();
+		}
+
+		bool Pop(std::string& text)
+		{
+			auto& slot = _slots[_dequeue_position & (RING_SIZE - 1)];
+			if (slot.sequence.load(std::memory_order_acquire) != _dequeue_position + 1)
+			{
+				return false;
+			}
+			text = std::move(slot.text);
+			slot.sequence.store(_dequeue_position + RING_SIZE, std::memory_order_release);
+			_dequeue_position++;
+			return true;
+		}
+
+		void Run(std::stop_token stop_token)
+		{
+			std::string text;
+			for (;;)
+			{
+				// read before popping, a message published after the last pop has changed it
+				auto signal = _signal.load(std::memory_order_acquire);
+
+				auto written = false;
+				while (Pop(text))
+				{
+					std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+					written = true;
+				}
+				if (written)
+				{
+					std::cout.flush();
+					_written.store(_dequeue_position, std::memory_order_release);
+					_written.notify_all();
+				}
+
+				if (stop_token.stop_requested())
+				{
+					return;
+				}
+				_signal.wait(signal, std::memory_order_acquire);
+			}
+		}
+
+		std::array<Slot, RING_SIZE> _slots;
+		std::atomic<size_t> _enqueue_position = 0;
+		// writer thread only
+		size_t _dequeue_position = 0;
+		std::atomic<size_t> _written = 0;
+		std::atomic<uint32_t> _signal = 0;
+		// last member, the thread is joined before the ring goes away
+		std::jthread _thread;
+	};
+
+	Writer& GetWriter()
+	{
+		static Writer writer;
+		return writer;
+	}
+}
+
+namespace logging
+{
+	namespace detail
+	{
+		std::atomic<ELevel> level = ELevel::Info;
+	}
+
+	void SetLevel(ELevel level)
+	{
+		detail::level.store(level, std::memory_order_relaxed);
+	}
+
+	void Write(std::string text)
+	{
+		GetWriter().Push(std::move(text));
+	}
+
+	void Flush()
+	{
+		GetWriter().Flush();
+	}
+}
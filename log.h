@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <format>
+#include <string>
+#include <utility>
+
+// Levels above this are compiled out, 3 keeps every level
+#ifndef DXG_LOG_MAX_LEVEL
+#define DXG_LOG_MAX_LEVEL 3
+#endif
+
+// Leveled console log. Through the macros below a disabled level costs one relaxed load, its arguments are
+// neither evaluated nor formatted, and levels above DXG_LOG_MAX_LEVEL are compiled out.
+// Enabled messages are formatted on the calling thread and handed to a background writer through a lock free
+// ring buffer, conversion threads never wait on stdout.
+namespace logging
+{
+	enum class ELevel
+	{
+		Error,
+		Warning,
+		Info,
+		Verbose
+	};
+
+	namespace detail
+	{
+		extern std::atomic<ELevel> level;
+	}
+
+	// Info unless changed
+	void SetLevel(ELevel level);
+
+	inline ELevel GetLevel()
+	{
+		return detail::level.load(std::memory_order_relaxed);
+	}
+
+	inline bool IsEnabled(ELevel level)
+	{
+		return static_cast<int>(level) <= DXG_LOG_MAX_LEVEL && level <= detail::level.load(std::memory_order_relaxed);
+	}
+
+	// Queues text as is, messages carry their own '\n'. Only waits when the writer is a whole ring behind.
+	void Write(std::string text);
+
+	// Returns once everything queued so far is on stdout
+	void Flush();
+
+	// Messages of one job, queued in one piece so lines of concurrent jobs don't interleave.
+	// Add evaluates its arguments whatever the level, call it through LOG_TO.
+	class Buffer
+	{
+	public:
+		template<class... Args>
+		void Add(ELevel level, std::format_string<Args...> format, Args&&... args)
+		{
+			if (IsEnabled(level))
+			{
+				_text += std::format(format, std::forward<Args>(args)...);
+			}
+		}
+
+		// Queues the collected text and starts over
+		void Flush()
+		{
+			if (!_text.empty())
+			{
+				Write(std::exchange(_text, {}));
+			}
+		}
+
+	private:
+		std::string _text;
+	};
+}
+
+#define DXG_LOG(level, ...) \
+	do \
+	{ \
+		if (::logging::IsEnabled(level)) \
+		{ \
+			::logging::Write(std::format(__VA_ARGS__)); \
+		} \
+	} while (false)
+
+// Adds to a logging::Buffer, arguments are only evaluated when the level is enabled
+#define LOG_TO(buffer, level, ...) \
+	do \
+	{ \
+		if (::logging::IsEnabled(level)) \
+		{ \
+			(buffer).Add(level, __VA_ARGS__); \
+		} \
+	} while (false)
+
+#define LOG_ERROR(...) DXG_LOG(::logging::ELevel::Error, __VA_ARGS__)
+#define LOG_WARNING(...) DXG_LOG(::logging::ELevel::Warning, __VA_ARGS__)
+#define LOG_INFO(...) DXG_LOG(::logging::ELevel::Info, __VA_ARGS__)
+#define LOG_VERBOSE(...) DXG_LOG(::logging::ELevel::Verbose, __VA_ARGS__)
@@ -0,0 +1,158 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& filename)
+{
+	if (!Map(filename))
+	{
+		Read(filename);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		_data = std::exchange(other._data, nullptr);
+		_size = std::exchange(other._size, 0);
+		_mapped = std::exchange(other._mapped, false);
+		// moving a vector keeps its heap buffer, so _data stays valid
+		_buffer = std::move(other._buffer);
+	}
+	return *this;
+}
+
+void MappedFile::Close()
+{
+	if (_mapped && _data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(_data);
+#else
+		munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+	}
+
+	_data = nullptr;
+	_size = 0;
+	_mapped = false;
+	_buffer.clear();
+	_buffer.shrink_to_fit();
+}
+
+bool MappedFile::Map(const std::filesystem::path& filename)
+{
+#ifdef _WIN32
+	auto file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	// the view keeps the mapping object alive
+	CloseHandle(mapping);
+	if (!view)
+	{
+		return false;
+	}
+
+	// equivalent of madvise(MADV_WILLNEED), the whole file is going to be walked
+	WIN32_MEMORY_RANGE_ENTRY range{ view, static_cast<SIZE_T>(file_size.QuadPart) };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+	_data = static_cast<const uint8_t*>(view);
+	_size = static_cast<size_t>(file_size.QuadPart);
+#else
+	auto fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat {};
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	auto view = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	madvise(view, file_stat.st_size, MADV_SEQUENTIAL);
+	madvise(view, file_stat.st_size, MADV_WILLNEED);
+
+	_data = static_cast<const uint8_t*>(view);
+	_size = static_cast<size_t>(file_stat.st_size);
+#endif
+	_mapped = true;
+	return true;
+}
+
+bool MappedFile::Read(const std::filesystem::path& filename)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+
+	auto file_size = static_cast<size_t>(file.tellg());
+	file.seekg(0, std::ios::beg);
+
+	_buffer.resize(file_size);
+	if (!file.read(reinterpret_cast<char*>(_buffer.data()), file_size))
+	{
+		_buffer.clear();
+		return false;
+	}
+
+	_data = _buffer.data();
+	_size = _buffer.size();
+	return true;
+}
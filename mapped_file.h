@@ -0,0 +1,58 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+// Read-only view of a whole file. The file is memory mapped with sequential/prefetch hints
+// when the platform allows it, otherwise it is loaded with one bulk read.
+// Format headers (dxg::FileHeader, mrb::FileHeader) overlay GetData() directly.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::filesystem::path& filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	std::span<const uint8_t> GetData() const
+	{
+		return { _data, _size };
+	}
+
+	const uint8_t* data() const
+	{
+		return _data;
+	}
+
+	size_t size() const
+	{
+		return _size;
+	}
+
+	bool empty() const
+	{
+		return _size == 0;
+	}
+
+	bool IsMapped() const
+	{
+		return _mapped;
+	}
+
+	void Close();
+
+private:
+	bool Map(const std::filesystem::path& filename);
+	bool Read(const std::filesystem::path& filename);
+
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+	bool _mapped = false;
+	// fallback storage when mapping is not possible
+	std::vector<uint8_t> _buffer;
+};
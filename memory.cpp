@@ -0,0 +1,347 @@
+#include "memory.h"
+
+#include <new>
+#include <bit>
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace
+{
+	constexpr int WATCH_COUNT = 64;
+
+	std::atomic<bool> enabled = false;
+	std::atomic<uint64_t> allocations = 0;
+	std::atomic<uint64_t> allocated_bytes = 0;
+	std::atomic<int64_t> live_bytes = 0;
+	std::atomic<int64_t> peak_bytes = 0;
+	// bit per watch slot in use, every allocation raises the peaks of the active ones
+	std::atomic<uint64_t> active_watches = 0;
+	std::atomic<int64_t> watch_peaks[WATCH_COUNT];
+
+	size_t GetBlockSize(void* block)
+	{
+#if defined(_WIN32)
+		return _msize(block);
+#elif defined(__APPLE__)
+		return malloc_size(block);
+#else
+		return malloc_usable_size(block);
+#endif
+	}
+
+	void RaisePeak(std::atomic<int64_t>& peak, int64_t value)
+	{
+		auto current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// usable size of a block from AllocateAligned, Windows keeps those apart from the malloc heap
+	size_t GetAlignedBlockSize(void* block, [[maybe_unused]] size_t alignment)
+	{
+#if defined(_WIN32)
+		return _aligned_msize(block, alignment, 0);
+#else
+		return GetBlockSize(block);
+#endif
+	}
+
+	void CountBytes(int64_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+		auto live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		RaisePeak(peak_bytes, live);
+		for (auto watches = active_watches.load(std::memory_order_relaxed); watches; watches &= watches - 1)
+		{
+			RaisePeak(watch_peaks[std::countr_zero(watches)], live);
+		}
+	}
+
+	void CountAllocation(void* block)
+	{
+		if (block && enabled.load(std::memory_order_relaxed))
+		{
+			CountBytes(static_cast<int64_t>(GetBlockSize(block)));
+		}
+	}
+
+	void CountFree(void* block)
+	{
+		if (block && enabled.load(std::memory_order_relaxed))
+		{
+			live_bytes.fetch_sub(static_cast<int64_t>(GetBlockSize(block)), std::memory_order_relaxed);
+		}
+	}
+
+	// backs the std::align_val_t forms of operator new, blocks go back through FreeAligned
+	void* AllocateAligned(size_t size, size_t alignment)
+	{
+		alignment = std::max(alignment, sizeof(void*));
+#if defined(_WIN32)
+		auto block = _aligned_malloc(size, alignment);
+#else
+		void* block = nullptr;
+		if (posix_memalign(&block, alignment, size) != 0)
+		{
+			block = nullptr;
+		}
+#endif
+		if (block && enabled.load(std::memory_order_relaxed))
+		{
+			CountBytes(static_cast<int64_t>(GetAlignedBlockSize(block, alignment)));
+		}
+		return block;
+	}
+
+	void FreeAligned(void* block, size_t alignment)
+	{
+		alignment = std::max(alignment, sizeof(void*));
+		if (block && enabled.load(std::memory_order_relaxed))
+		{
+			live_bytes.fetch_sub(static_cast<int64_t>(GetAlignedBlockSize(block, alignment)), std::memory_order_relaxed);
+		}
+#if defined(_WIN32)
+		_aligned_free(block);
+#else
+		std::free(block);
+#endif
+	}
+
+	// operator new semantics over allocate(): retries through the new handler, throws std::bad_alloc without one
+	template<class Allocate>
+	void* NewBlock(Allocate&& allocate)
+	{
+		for (;;)
+		{
+			if (auto block = allocate())
+			{
+				return block;
+			}
+			auto handler = std::get_new_handler();
+			if (!handler)
+			{
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+}
+
+namespace memory
+{
+	void Enable()
+	{
+		enabled = true;
+	}
+
+	bool IsEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	Stats GetStats()
+	{
+		return {
+			allocations.load(std::memory_order_relaxed),
+			allocated_bytes.load(std::memory_order_relaxed),
+			live_bytes.load(std::memory_order_relaxed),
+			peak_bytes.load(std::memory_order_relaxed)
+		};
+	}
+
+	PeakWatch::PeakWatch()
+	{
+		if (!IsEnabled())
+		{
+			return;
+		}
+
+		auto watches = active_watches.load(std::memory_order_relaxed);
+		while (~watches)
+		{
+			auto slot = std::countr_one(watches);
+			if (active_watches.compare_exchange_weak(watches, watches | (uint64_t(1) << slot), std::memory_order_relaxed))
+			{
+				_slot = slot;
+				watch_peaks[slot].store(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	PeakWatch::~PeakWatch()
+	{
+		if (_slot >= 0)
+		{
+			active_watches.fetch_and(~(uint64_t(1) << _slot), std::memory_order_relaxed);
+		}
+	}
+
+	int64_t PeakWatch::GetPeak() const
+	{
+		if (_slot < 0)
+		{
+			return peak_bytes.load(std::memory_order_relaxed);
+		}
+		return watch_peaks[_slot].load(std::memory_order_relaxed);
+	}
+
+	void* Allocate(size_t size)
+	{
+		auto block = std::malloc(size);
+		CountAllocation(block);
+		return block;
+	}
+
+	void* AllocateZeroed(size_t count, size_t size)
+	{
+		auto block = std::calloc(count, size);
+		CountAllocation(block);
+		return block;
+	}
+
+	void* Reallocate(void* block, size_t size)
+	{
+		auto old_size = block && IsEnabled() ? static_cast<int64_t>(GetBlockSize(block)) : 0;
+		auto result = std::realloc(block, size);
+		// a failed realloc leaves the block as it was
+		if (result || !size)
+		{
+			live_bytes.fetch_sub(old_size, std::memory_order_relaxed);
+			CountAllocation(result);
+		}
+		return result;
+	}
+
+	void Free(void* block)
+	{
+		CountFree(block);
+		std::free(block);
+	}
+}
+
+// Every replaceable form is defined so container, string and over-aligned allocations are all counted and
+// no form falls back to the default allocator with a block it didn't allocate. Sizes passed to the sized
+// deletes are ignored, the block size comes from the allocator like it does for the FBX SDK handlers.
+void* operator new(std::size_t size)
+{
+	return NewBlock([&] { return memory::Allocate(size ? size : 1); });
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* block) noexcept
+{
+	memory::Free(block);
+}
+
+void operator delete[](void* block) noexcept
+{
+	memory::Free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+	memory::Free(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept
+{
+	memory::Free(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept
+{
+	memory::Free(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept
+{
+	memory::Free(block);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return NewBlock([&] { return AllocateAligned(size ? size : 1, static_cast<size_t>(alignment)); });
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size, alignment);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, alignment, tag);
+}
+
+void operator delete(void* block, std::align_val_t alignment) noexcept
+{
+	FreeAligned(block, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* block, std::align_val_t alignment) noexcept
+{
+	FreeAligned(block, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t alignment) noexcept
+{
+	FreeAligned(block, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* block, std::size_t, std::align_val_t alignment) noexcept
+{
+	FreeAligned(block, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* block, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	FreeAligned(block, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void* block, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	FreeAligned(block, static_cast<size_t>(alignment));
+}
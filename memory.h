@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Optional allocation accounting for --memory. Every form of global operator new/delete, aligned ones included,
+// is replaced in memory.cpp and counts while enabled, the FBX SDK allocator handlers go through the counting
+// malloc family below. Sizes are the usable size of each block. The replacements are linked in whether or
+// not --memory is given, while disabled they cost one relaxed atomic load per allocation and free.
+namespace memory
+{
+	// Call before the big allocations start, blocks allocated earlier are only seen when they are freed
+	void Enable();
+	bool IsEnabled();
+
+	// Totals since Enable, process wide
+	struct Stats
+	{
+		uint64_t allocations = 0;
+		uint64_t allocated_bytes = 0;
+		// may dip below 0 by what was allocated before Enable
+		int64_t live_bytes = 0;
+		int64_t peak_bytes = 0;
+	};
+	Stats GetStats();
+
+	// Highest live byte count of the process while the watch exists. A limited number of watches can be
+	// active at once, the others fall back to the all time peak.
+	class PeakWatch
+	{
+	public:
+		PeakWatch();
+		~PeakWatch();
+
+		PeakWatch(const PeakWatch&) = delete;
+		PeakWatch& operator=(const PeakWatch&) = delete;
+
+		int64_t GetPeak() const;
+
+	private:
+		int _slot = -1;
+	};
+
+	// Counting malloc/calloc/realloc/free, signatures match the FBX SDK handler types
+	void* Allocate(size_t size);
+	void* AllocateZeroed(size_t count, size_t size);
+	void* Reallocate(void* block, size_t size);
+	void Free(void* block);
+}
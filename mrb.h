@@ -2,6 +2,7 @@
 #include <span>
 #include <vector>
 #include <string_view>
+#include <cstring>
 
 #include "magic_enum.h"
 #include "common.h"
@@ -0,0 +1,161 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstring>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+#include "mrb.h"
+
+namespace mrb
+{
+	// Data blocks of one animation, located with a single scan of data_bitfield.
+	class AnimationBlocks
+	{
+	public:
+		AnimationBlocks() = default;
+
+		explicit AnimationBlocks(const AnimationHeader* header)
+			: _header(header)
+		{
+			using namespace magic_enum::bitwise_operators;
+
+			uint32_t offset = sizeof(AnimationHeader);
+
+			for (int data_idx = 0; data_idx < 32; data_idx++)
+			{
+				auto current_type = static_cast<EAnimationDataType>(1u << data_idx);
+				if ((header->data_bitfield & current_type) == current_type)
+				{
+					_offsets[data_idx] = offset;
+
+					auto block = reinterpret_cast<const AnimationDataBlock*>(
+						reinterpret_cast<const uint8_t*>(header) + offset
+						);
+
+					offset += block->elements_count * block->element_size + sizeof(AnimationDataBlock);
+
+					// align to 4 bytes
+					constexpr auto alignment = 4;
+					constexpr auto mask = alignment - 1;
+					offset = offset + (-offset & mask);
+				}
+			}
+		}
+
+		const AnimationHeader* GetHeader() const
+		{
+			return _header;
+		}
+
+		std::string_view GetName() const
+		{
+			return { _header->name, strnlen(_header->name, sizeof(_header->name)) };
+		}
+
+		const AnimationDataBlock* GetDataBlock(EAnimationDataType type) const
+		{
+			auto offset = _offsets[std::countr_zero(static_cast<uint32_t>(type))];
+			if (offset == 0)
+			{
+				return nullptr;
+			}
+
+			return reinterpret_cast<const AnimationDataBlock*>(
+				reinterpret_cast<const uint8_t*>(_header) + offset
+				);
+		}
+
+		template<class T>
+		const T* GetDataBlock() const
+		{
+			return static_cast<const T*>(GetDataBlock(T::TYPE));
+		}
+
+	private:
+		const AnimationHeader* _header = nullptr;
+		// offset from the animation header per bit of EAnimationDataType, 0 when the block is absent
+		std::array<uint32_t, 32> _offsets{};
+	};
+
+	// Directory of every animation inside an MRB file, built with a single walk over the headers.
+	class AnimationIndex
+	{
+	public:
+		AnimationIndex() = default;
+
+		explicit AnimationIndex(const FileHeader* file_header)
+		{
+			_animations.reserve(file_header->animation_count);
+
+			auto header = reinterpret_cast<const AnimationHeader*>(
+				reinterpret_cast<const uint8_t*>(file_header) +
+				sizeof(FileHeader)
+				);
+
+			for (uint32_t animation_idx = 0; animation_idx < file_header->animation_count; animation_idx++)
+			{
+				auto& blocks = _animations.emplace_back(header);
+				_names.emplace(blocks.GetName(), static_cast<int>(animation_idx));
+
+				header = reinterpret_cast<const AnimationHeader*>(
+					reinterpret_cast<const uint8_t*>(header) +
+					header->data_size
+					);
+			}
+		}
+
+		size_t GetAnimationCount() const
+		{
+			return _animations.size();
+		}
+
+		const AnimationBlocks& GetAnimation(int index) const
+		{
+			return _animations[index];
+		}
+
+		// returns nullptr if there is no animation with such name
+		const AnimationBlocks* FindAnimation(std::string_view name) const
+		{
+			auto it = _names.find(name);
+			if (it == _names.end())
+			{
+				return nullptr;
+			}
+			return &_animations[it->second];
+		}
+
+		// Locates a single animation without building the whole directory,
+		// only the headers in front of it are touched and only its own blocks are resolved.
+		static bool FindAnimation(const FileHeader* file_header, std::string_view name, AnimationBlocks& result)
+		{
+			auto header = reinterpret_cast<const AnimationHeader*>(
+				reinterpret_cast<const uint8_t*>(file_header) +
+				sizeof(FileHeader)
+				);
+
+			for (uint32_t animation_idx = 0; animation_idx < file_header->animation_count; animation_idx++)
+			{
+				if (std::string_view(header->name, strnlen(header->name, sizeof(header->name))) == name)
+				{
+					result = AnimationBlocks(header);
+					return true;
+				}
+
+				header = reinterpret_cast<const AnimationHeader*>(
+					reinterpret_cast<const uint8_t*>(header) +
+					header->data_size
+					);
+			}
+
+			return false;
+		}
+
+	private:
+		std::vector<AnimationBlocks> _animations;
+		// first animation wins if names repeat
+		std::unordered_map<std::string_view, int> _names;
+	};
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+#include "trace.h"
+
+// Fork/join over an index range for the conversion and export stages.
+// Work is handed out one item at a time, so results only depend on the index, never on the thread.
+namespace parallel
+{
+	// 0 means one thread per core
+	inline unsigned ResolveThreadCount(unsigned thread_count)
+	{
+		return thread_count ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Calls body(i) for every i in [0, count) on up to thread_count threads, the calling thread included.
+	// Returns once every item is done. If items throw, the exception of the lowest index is rethrown.
+	template<class Body>
+	void For(size_t count, unsigned thread_count, Body&& body)
+	{
+		std::atomic<size_t> next_item = 0;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+		size_t error_item = count;
+
+		auto worker = [&]()
+		{
+			trace::Scope scope("parallel::For");
+			for (auto item = next_item++; item < count; item = next_item++)
+			{
+				try
+				{
+					body(item);
+				}
+				catch (...)
+				{
+					std::lock_guard lock(error_mutex);
+					if (item < error_item)
+					{
+						error = std::current_exception();
+						error_item = item;
+					}
+				}
+			}
+		};
+
+		thread_count = static_cast<unsigned>(std::min<size_t>(ResolveThreadCount(thread_count), count));
+		{
+			std::vector<std::jthread> threads;
+			for (unsigned i = 1; i < thread_count; i++)
+			{
+				threads.emplace_back(worker);
+			}
+			worker();
+		}
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,704 @@
+#include "scene_ir.h"
+
+#include <cmath>
+#include <array>
+#include <numbers>
+#include <iostream>
+#include <format>
+#include <cassert>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "magic_enum.h"
+#include "dxg_index.h"
+#include "mrb.h"
+#include "mrb_index.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "log.h"
+#include "trace.h"
+
+namespace
+{
+	// Decoded output of one group data block, merged in block order once every block is done
+	struct GroupDataResult
+	{
+		// first vertex/index of the block inside its group, prefix sums over the preceding blocks
+		size_t vertex_base = 0;
+		size_t index_base = 0;
+		// bones of the block in first use order
+		std::vector<int> skin_bones;
+		// log lines of the block, queued during the merge so the output doesn't depend on scheduling
+		logging::Buffer log;
+	};
+
+	// Sizes every stream of the group once from the index, blocks then write straight into their slice
+	void PrepareMeshGroup(const dxg::MeshGroupIndex& mesh_group_index, int mesh_group_idx, ir::MeshGroup& group)
+	{
+		const auto& group_entry = mesh_group_index.GetGroup(mesh_group_idx);
+		for (auto&& group_data_entry : mesh_group_index.GetGroupData(mesh_group_idx))
+		{
+			auto mesh_group_data_header = mesh_group_index.GetMeshGroupDataHeader(group_data_entry);
+			group.has_uvs_2 |= mesh_group_data_header->uv_2_count != 0;
+			group.has_colors |= mesh_group_data_header->color_count != 0;
+		}
+
+		size_t vertex_count = group_entry.control_point_count;
+		group.has_geometry = true;
+		group.positions.resize(vertex_count);
+		group.normals.resize(vertex_count);
+		group.uvs.resize(vertex_count);
+		if (group.has_uvs_2)
+		{
+			group.uvs_2.resize(vertex_count);
+		}
+		if (group.has_colors)
+		{
+			group.colors.assign(vertex_count, ColorRGBA{ 255, 255, 255, 255 });
+		}
+		group.joints.resize(vertex_count * 3);
+		group.weights.resize(vertex_count * 3);
+		group.indices.resize(group_entry.face_count * 3);
+	}
+
+	// Decodes the meshes of one group data block into the group slice starting at result.vertex_base/index_base.
+	// Blocks of a group touch disjoint slices, so they can run concurrently.
+	void BuildGroupData(const dxg::MeshGroupIndex& mesh_group_index, const dxg::MeshGroupIndex::GroupDataEntry& group_data_entry,
+		int group_data_idx, const Skeleton& skeleton, ir::MeshGroup& group, GroupDataResult& result)
+	{
+		trace::Scope scope("BuildGroupData", group.name);
+		auto mesh_group_data_header = mesh_group_index.GetMeshGroupDataHeader(group_data_entry);
+		auto mesh_group_data = mesh_group_index.GetMeshGroupDataView(group_data_entry);
+		LOG_TO(result.log, logging::ELevel::Verbose,
+			"Located mesh group data header {}, data size {}, positions {}, normals {}, "
+			"uv_1_count {}, uv_2_count {}, colors {}, weights {}\n",
+			group_data_idx, mesh_group_data_header->data_size, mesh_group_data_header->position_count,
+			mesh_group_data_header->normal_count, mesh_group_data_header->uv_1_count,
+			mesh_group_data_header->uv_2_count, mesh_group_data_header->color_count,
+			mesh_group_data_header->weights_count
+		);
+
+		assert(!(mesh_group_data_header->weights_count % mesh_group_data_header->position_count));
+
+		// per mesh scratch, reused across the meshes of the block
+		std::vector<int> weighted_bones;
+		std::vector<dxg::BoneWeights> vertex_bone_weights;
+		auto vertex_offset = result.vertex_base;
+		auto indices_offset = result.index_base;
+
+		for (int mesh_idx = 0; mesh_idx < mesh_group_data_header->mesh_count; mesh_idx++)
+		{
+			auto mesh_header = mesh_group_index.GetMeshHeader(group_data_entry, mesh_idx);
+
+			LOG_TO(result.log, logging::ELevel::Verbose, "Located mesh header {}, data size {}, weighted bones {}, vertices {}, faces {}, weight bone indices {} unk5 {} unk6 {} unk7 {}\n",
+				mesh_idx, mesh_header->data_size, mesh_header->weight_bone_count, mesh_header->vertex_count,
+				mesh_header->face_count, mesh_header->weight_bone_indices_count, mesh_header->unk5,
+				mesh_header->unk6, mesh_header->unk7
+			);
+
+			assert(mesh_header->weight_bone_count <= 8);
+			assert(mesh_header->weight_bone_indices_count == 0 || mesh_header->vertex_count * 3 == mesh_header->weight_bone_indices_count);
+
+			auto vertices_data = mesh_header->GetVertexDataIndices();
+			auto faces = mesh_header->GetFaces();
+			auto weight_bone_indices = mesh_header->GetWeightBoneIndices();
+
+			// weighted bone index -> skeleton bone, resolved once per mesh
+			weighted_bones.clear();
+			if (mesh_header->weight_bone_count)
+			{
+				auto weighted_bone_names = mesh_header->GetWeightedBoneNames()->Parse();
+				assert(mesh_header->weight_bone_count == weighted_bone_names.size());
+
+				for (auto& weight_bone_name : weighted_bone_names)
+				{
+					auto bone = skeleton.FindBone(weight_bone_name);
+					if (bone == -1)
+					{
+						throw std::logic_error(std::format("Mesh is influenced by unknown bone '{}'\n", weight_bone_name));
+					}
+
+					if (std::ranges::find(result.skin_bones, bone) == result.skin_bones.end())
+					{
+						result.skin_bones.push_back(bone);
+					}
+					weighted_bones.push_back(bone);
+				}
+			}
+			else
+			{
+				LOG_TO(result.log, logging::ELevel::Verbose, "Mesh is not skinned\n");
+			}
+
+			kernels::GatherVertexAttribute(group.positions.data() + vertex_offset, mesh_group_data.positions, vertices_data, &dxg::VertexDataIndices::position_index);
+			kernels::GatherVertexAttribute(group.normals.data() + vertex_offset, mesh_group_data.normals, vertices_data, &dxg::VertexDataIndices::normal_index);
+			kernels::GatherVertexAttribute(group.uvs.data() + vertex_offset, mesh_group_data.uvs, vertices_data, &dxg::VertexDataIndices::uv_index);
+
+			if (mesh_group_data_header->uv_2_count)
+			{
+				kernels::GatherVertexAttribute(group.uvs_2.data() + vertex_offset, mesh_group_data.uvs_2, vertices_data, &dxg::VertexDataIndices::uv_2_index);
+			}
+
+			if (mesh_group_data_header->color_count)
+			{
+				kernels::GatherVertexAttribute(group.colors.data() + vertex_offset, mesh_group_data.colors, vertices_data, &dxg::VertexDataIndices::color_index);
+			}
+
+			if (mesh_header->weight_bone_count && mesh_header->weight_bone_indices_count)
+			{
+				vertex_bone_weights.resize(vertices_data.size());
+				kernels::GatherVertexAttribute(vertex_bone_weights.data(), mesh_group_data.weights, vertices_data, &dxg::VertexDataIndices::position_index);
+
+				auto weights = group.weights.data() + vertex_offset * 3;
+				auto joints = group.joints.data() + vertex_offset * 3;
+				kernels::ExpandBoneWeights(reinterpret_cast<const float*>(vertex_bone_weights.data()), vertices_data.size(), weights);
+				kernels::ResolveJoints(weights, reinterpret_cast<const int8_t*>(weight_bone_indices.data()), weighted_bones, vertices_data.size(), joints);
+			}
+
+			auto face_indices = std::span<const uint16_t>(reinterpret_cast<const uint16_t*>(faces.data()), faces.size() * 3);
+			kernels::RebaseIndices(face_indices, static_cast<uint32_t>(vertex_offset), group.indices.data() + indices_offset);
+
+			vertex_offset += vertices_data.size();
+			indices_offset += face_indices.size();
+
+			/*for (auto vetex_indices : mesh_header->GetVertexDataIndices())
+			{
+				std::cout << std::format("Vertex indices: pos {}, normal {}, uv {} uv2 {} color {}\n",
+					vetex_indices.position_index, vetex_indices.normal_index, vetex_indices.uv_index,
+					vetex_indices.uv_2_index, vetex_indices.color_index
+				);
+			}*/
+
+			/*for (auto face : mesh_header->GetFaces())
+			{
+				std::cout << std::format("Face {} {} {}\n",
+					face.indices[0], face.indices[1], face.indices[2]
+				);
+			}*/
+		}
+	}
+
+	void BuildAnimationClip(const mrb::AnimationBlocks& animation, const Skeleton& skeleton, std::vector<ir::AnimationClip>& clips,
+		logging::Buffer& log)
+	{
+		using namespace magic_enum::bitwise_operators;
+
+		trace::Scope scope("BuildAnimationClip", animation.GetName());
+		auto animation_header = animation.GetHeader();
+		LOG_TO(log, logging::ELevel::Verbose, "Located animation '{}', data size {}, bitfield '{}'\n",
+			animation_header->name, animation_header->data_size, magic_enum::enum_flags_name(animation_header->data_bitfield));
+
+		constexpr auto required_data_blocks =
+			mrb::EAnimationDataType::Bones | mrb::EAnimationDataType::Keyframes |
+			mrb::EAnimationDataType::Positions | mrb::EAnimationDataType::Rotations |
+			mrb::EAnimationDataType::Scales | mrb::EAnimationDataType::IndexMap;
+		if ((animation_header->data_bitfield & required_data_blocks) != required_data_blocks)
+		{
+			LOG_TO(log, logging::ELevel::Warning, "Animation '{}', doesn't have all requiered data blocks {}\n", animation_header->name, magic_enum::enum_flags_name(required_data_blocks));
+			return;
+		}
+
+		for (int data_idx = 0; data_idx < 32; data_idx++)
+		{
+			auto type = static_cast<mrb::EAnimationDataType>(1 << data_idx);
+			if (auto block = animation.GetDataBlock(type))
+			{
+				LOG_TO(log, logging::ELevel::Verbose, "Located data block {} {}, elements count {} element size {}\n", (void*)(block), magic_enum::enum_name(type), block->elements_count, block->element_size);
+			}
+		}
+
+		auto bones_block = animation.GetDataBlock<mrb::BoneNamesBlock>();
+		auto keyframes_block = animation.GetDataBlock<mrb::KeyframesBlock>();
+		auto positions_block = animation.GetDataBlock<mrb::PositionsBlock>();
+		auto rotations_block = animation.GetDataBlock<mrb::RotationsBlock>();
+		auto scales_block = animation.GetDataBlock<mrb::ScalesBlock>();
+		auto index_map_block = animation.GetDataBlock<mrb::IndexMapBlock>();
+
+		assert(keyframes_block->element_size == sizeof(uint32_t));
+		assert(positions_block->element_size == sizeof(Vector3));
+		assert(rotations_block->element_size == sizeof(Vector4));
+		assert(scales_block->element_size == sizeof(Vector3));
+		assert(index_map_block->element_size == sizeof(mrb::IndexMapElement) * keyframes_block->elements_count);
+
+		if (auto unk4_block = animation.GetDataBlock<mrb::Unk4Block>())
+		{
+			LOG_TO(log, logging::ELevel::Verbose, "Unk4 {}\n", unk4_block->GetData()[0]);
+		}
+
+		auto bone_names = bones_block->GetBoneNames();
+		auto keyframes = keyframes_block->GetKeyframes();
+		auto positions = positions_block->GetPositions();
+		auto rotations = rotations_block->GetRotations();
+		auto scales = scales_block->GetScales();
+		auto indices_map = index_map_block->GetIndexes();
+
+		assert(index_map_block->elements_count == bone_names.size());
+
+		// every pooled rotation converted once, tracks pick their keys through the index map
+		std::vector<Vector3> euler_rotations(rotations.size());
+		kernels::QuaternionsToEuler(reinterpret_cast<const float*>(rotations.data()), rotations.size(), reinterpret_cast<float*>(euler_rotations.data()));
+
+		auto& clip = clips.emplace_back();
+		clip.name = animation.GetName();
+		clip.key_times.assign(keyframes.begin(), keyframes.end());
+		clip.tracks.reserve(bone_names.size());
+
+		for (size_t bone_idx = 0; bone_idx < bone_names.size(); bone_idx++)
+		{
+			auto bone_name = bone_names[bone_idx];
+			auto bone = skeleton.FindBone(bone_name);
+			if (bone == -1)
+			{
+				LOG_TO(log, logging::ELevel::Warning, "Bone '{}' not found in skeleton\n", bone_name);
+				continue;
+			}
+
+			auto& track = clip.tracks.emplace_back();
+			track.bone = bone;
+			track.translations.resize(keyframes.size());
+			track.rotations.resize(keyframes.size());
+			track.euler_rotations.resize(keyframes.size());
+			track.scales.resize(keyframes.size());
+
+			auto bone_indices_map = indices_map.subspan(bone_idx * keyframes.size(), keyframes.size());
+			for (size_t keyframe_idx = 0; keyframe_idx < keyframes.size(); keyframe_idx++)
+			{
+				auto indices = bone_indices_map[keyframe_idx];
+				track.translations[keyframe_idx] = positions[indices.position_index];
+				track.rotations[keyframe_idx] = rotations[indices.rotation_index];
+				track.euler_rotations[keyframe_idx] = euler_rotations[indices.rotation_index];
+				track.scales[keyframe_idx] = scales[indices.scale_index];
+			}
+
+			kernels::AlignQuaternionHemispheres(reinterpret_cast<float*>(track.rotations.data()), keyframes.size());
+			kernels::UnrollEulerAngles(reinterpret_cast<float*>(track.euler_rotations.data()), keyframes.size());
+		}
+	}
+
+	template<class Vector>
+	bool SameSample(const Vector& a, const Vector& b)
+	{
+		return std::ranges::equal(a.raw, b.raw);
+	}
+
+	// A key whose sample repeats both neighbours lies on the line between them, consecutive MRB keys
+	// pointing at the same pool entry end up here. same(i, j) compares the samples of keys i and j.
+	template<class Same>
+	std::vector<uint32_t> DropRepeatedKeys(size_t key_count, Same&& same)
+	{
+		std::vector<uint32_t> keys;
+		for (size_t key_idx = 0; key_idx < key_count; key_idx++)
+		{
+			if (key_idx == 0 || key_idx + 1 == key_count || !same(key_idx - 1, key_idx) || !same(key_idx, key_idx + 1))
+			{
+				keys.push_back(static_cast<uint32_t>(key_idx));
+			}
+		}
+		// only the ends are left when every key repeats its neighbours
+		if (keys.size() == 2 && same(0, key_count - 1))
+		{
+			keys.pop_back();
+		}
+		return keys;
+	}
+
+	// Whether lerping the samples of keys first and last reproduces every sample in between within tolerance
+	bool FitsSegment(std::span<const uint32_t> key_times, std::span<const Vector3> values, size_t first, size_t last, float tolerance)
+	{
+		auto duration = static_cast<float>(key_times[last] - key_times[first]);
+		for (auto key_idx = first + 1; key_idx < last; key_idx++)
+		{
+			auto t = duration > 0.f ? static_cast<float>(key_times[key_idx] - key_times[first]) / duration : 0.f;
+			for (int component = 0; component < 3; component++)
+			{
+				auto from = values[first].raw[component];
+				auto value = from + (values[last].raw[component] - from) * t;
+				if (std::abs(value - values[key_idx].raw[component]) > tolerance)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool IsConstant(std::span<const Vector3> values, float tolerance)
+	{
+		return std::ranges::all_of(values, [&](const Vector3& value)
+		{
+			return std::abs(value.x - values.front().x) <= tolerance && std::abs(value.y - values.front().y) <= tolerance &&
+				std::abs(value.z - values.front().z) <= tolerance;
+		});
+	}
+
+	using Rotation = std::array<double, 4>;
+
+	Rotation Normalize(Rotation rotation)
+	{
+		auto length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+		for (auto& component : rotation)
+		{
+			component /= length;
+		}
+		return rotation;
+	}
+
+	Rotation Normalize(const Vector4& quaternion)
+	{
+		return Normalize(Rotation{ quaternion.x, quaternion.y, quaternion.z, quaternion.w });
+	}
+
+	// Angle in degrees of the rotation taking a to b. |a - b| of unit quaternions in the same hemisphere
+	// is 2 sin(angle / 4), which stays exact for the hundredths of a degree acos(dot) can't resolve.
+	double GetRotationDistance(const Rotation& a, const Rotation& b)
+	{
+		double difference = 0.0;
+		double sum = 0.0;
+		for (int component = 0; component < 4; component++)
+		{
+			difference += (a[component] - b[component]) * (a[component] - b[component]);
+			sum += (a[component] + b[component]) * (a[component] + b[component]);
+		}
+		auto chord = std::sqrt(std::min(difference, sum));
+		return 4.0 * std::asin(std::min(chord / 2.0, 1.0)) * 180.0 / std::numbers::pi;
+	}
+
+	bool IsConstant(std::span<const Vector4> rotations, float tolerance)
+	{
+		auto first = Normalize(rotations.front());
+		return std::ranges::all_of(rotations, [&](const Vector4& rotation)
+		{
+			return GetRotationDistance(Normalize(rotation), first) <= tolerance;
+		});
+	}
+
+	// Whether the shortest path slerp of keys first and last, what glTF players do between rotation keys,
+	// stays within tolerance degrees of every sample in between
+	bool FitsSlerpSegment(std::span<const uint32_t> key_times, std::span<const Vector4> rotations, size_t first, size_t last, float tolerance)
+	{
+		auto from = Normalize(rotations[first]);
+		auto to = Normalize(rotations[last]);
+		auto dot = from[0] * to[0] + from[1] * to[1] + from[2] * to[2] + from[3] * to[3];
+		if (dot < 0.0)
+		{
+			for (auto& component : to)
+			{
+				component = -component;
+			}
+			dot = -dot;
+		}
+		auto angle = std::acos(std::min(dot, 1.0));
+
+		auto duration = static_cast<double>(key_times[last] - key_times[first]);
+		for (auto key_idx = first + 1; key_idx < last; key_idx++)
+		{
+			auto t = duration > 0.0 ? static_cast<double>(key_times[key_idx] - key_times[first]) / duration : 0.0;
+			// nearly equal ends fall back to lerp, the normalization below makes it a valid rotation
+			auto from_weight = angle > 1e-9 ? std::sin((1.0 - t) * angle) / std::sin(angle) : 1.0 - t;
+			auto to_weight = angle > 1e-9 ? std::sin(t * angle) / std::sin(angle) : t;
+			Rotation interpolated;
+			for (int component = 0; component < 4; component++)
+			{
+				interpolated[component] = from[component] * from_weight + to[component] * to_weight;
+			}
+			if (GetRotationDistance(Normalize(interpolated), Normalize(rotations[key_idx])) > tolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Greedy linear fit, each segment grows from the last kept key while fits(first, last) says its ends still
+	// reproduce the samples in between. A constant channel keeps its first key only.
+	template<class Fits>
+	std::vector<uint32_t> FitLinearKeys(size_t key_count, bool constant, Fits&& fits)
+	{
+		// bounds the quadratic cost of checking a segment on long smooth channels
+		constexpr size_t MAX_SEGMENT_KEYS = 256;
+
+		if (constant)
+		{
+			return { 0 };
+		}
+
+		std::vector<uint32_t> keys = { 0 };
+		size_t anchor = 0;
+		for (size_t last = 2; last < key_count; last++)
+		{
+			if (last - anchor > MAX_SEGMENT_KEYS || !fits(anchor, last))
+			{
+				anchor = last - 1;
+				keys.push_back(static_cast<uint32_t>(anchor));
+			}
+		}
+		keys.push_back(static_cast<uint32_t>(key_count - 1));
+		return keys;
+	}
+
+	std::vector<uint32_t> FitLinearKeys(std::span<const uint32_t> key_times, std::span<const Vector3> values, float tolerance)
+	{
+		return FitLinearKeys(values.size(), IsConstant(values, tolerance), [&](size_t first, size_t last)
+		{
+			return FitsSegment(key_times, values, first, last, tolerance);
+		});
+	}
+
+	// Moves the samples of the kept keys to the front and drops the rest
+	template<class Vector>
+	void KeepSamples(std::span<const uint32_t> keys, std::vector<Vector>& values)
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			values[i] = values[keys[i]];
+		}
+		values.resize(keys.size());
+	}
+}
+
+namespace ir
+{
+	std::vector<MeshGroup> BuildMeshGroups(const dxg::FileHeader* file_header, const Skeleton& skeleton, unsigned thread_count)
+	{
+		std::vector<MeshGroup> result;
+
+		auto mesh_group_list_header = file_header->GetMeshGroupListHeader();
+		if (!mesh_group_list_header)
+		{
+			return result;
+		}
+
+		LOG_VERBOSE("Located mesh group list header, data size {}\n", mesh_group_list_header->data_size);
+
+		auto group_names = mesh_group_list_header->GetGroupNames()->Parse();
+
+		assert(mesh_group_list_header->group_count == group_names.size());
+
+		dxg::MeshGroupIndex mesh_group_index(mesh_group_list_header);
+		// the index is addressed with int
+		auto group_count = static_cast<int>(mesh_group_list_header->group_count);
+
+		// Parse method for 10001 or lower, 10002 and 10003 would go here
+		auto has_parser = file_header->GetVersion() >= 0x10002;
+
+		// one job per group data block of every group, same numbering as the index.
+		// Bases are assigned up front so the merge doesn't depend on which block finishes first.
+		struct GroupDataJob
+		{
+			int mesh_group_idx;
+			int group_data_idx;
+		};
+		std::vector<GroupDataJob> jobs;
+		std::vector<GroupDataResult> job_results;
+
+		result.resize(group_count);
+		for (int mesh_group_idx = 0; mesh_group_idx < group_count; mesh_group_idx++)
+		{
+			auto& group = result[mesh_group_idx];
+			group.name = group_names[mesh_group_idx];
+			if (!has_parser)
+			{
+				continue;
+			}
+
+			PrepareMeshGroup(mesh_group_index, mesh_group_idx, group);
+
+			size_t vertex_base = 0;
+			size_t index_base = 0;
+			auto group_data_entries = mesh_group_index.GetGroupData(mesh_group_idx);
+			for (int group_data_idx = 0; group_data_idx < static_cast<int>(group_data_entries.size()); group_data_idx++)
+			{
+				jobs.push_back({ mesh_group_idx, group_data_idx });
+				auto& job_result = job_results.emplace_back();
+				job_result.vertex_base = vertex_base;
+				job_result.index_base = index_base;
+				vertex_base += group_data_entries[group_data_idx].control_point_count;
+				index_base += group_data_entries[group_data_idx].face_count * 3;
+			}
+		}
+
+		std::vector<std::exception_ptr> job_errors(jobs.size());
+		parallel::For(jobs.size(), thread_count, [&](size_t job)
+		{
+			try
+			{
+				const auto& [mesh_group_idx, group_data_idx] = jobs[job];
+				const auto& group_data_entry = mesh_group_index.GetGroupData(mesh_group_idx)[group_data_idx];
+				BuildGroupData(mesh_group_index, group_data_entry, group_data_idx, skeleton, result[mesh_group_idx], job_results[job]);
+			}
+			catch (...)
+			{
+				// rethrown during the merge, after the logs of the blocks before it
+				job_errors[job] = std::current_exception();
+			}
+		});
+
+		// merge in file order, the output is the same whatever the thread count
+		size_t job = 0;
+		for (int mesh_group_idx = 0; mesh_group_idx < group_count; mesh_group_idx++)
+		{
+			auto& group = result[mesh_group_idx];
+
+			LOG_VERBOSE("Located mesh group header '{}', data size {}\n", group.name, mesh_group_index.GetMeshGroupHeader(mesh_group_idx)->data_size);
+
+			if (!has_parser)
+			{
+				LOG_WARNING("Unimplemented version\n");
+				continue;
+			}
+
+			std::vector<bool> bone_used(skeleton.GetBoneCount());
+			for (size_t end = job + mesh_group_index.GetGroupData(mesh_group_idx).size(); job < end; job++)
+			{
+				job_results[job].log.Flush();
+				if (job_errors[job])
+				{
+					std::rethrow_exception(job_errors[job]);
+				}
+
+				for (auto bone : job_results[job].skin_bones)
+				{
+					if (!bone_used[bone])
+					{
+						bone_used[bone] = true;
+						group.skin_bones.push_back(bone);
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+
+	bool BuildAnimationClips(std::span<const uint8_t> file, const Skeleton& skeleton, std::span<const std::string> clip_names,
+		std::vector<AnimationClip>& clips, logging::Buffer& log)
+	{
+		if (file.size() < sizeof(mrb::FileHeader))
+		{
+			LOG_TO(log, logging::ELevel::Error, "File is too small\n");
+			return false;
+		}
+
+		auto mrb_header = reinterpret_cast<const mrb::FileHeader*>(file.data());
+
+		if (strcmp(mrb_header->signature, "MRB") != 0)
+		{
+			LOG_TO(log, logging::ELevel::Error, "Signature missmatch\n");
+			return false;
+		}
+
+		if (mrb_header->magic != 9)
+		{
+			LOG_TO(log, logging::ELevel::Error, "Magic missmatch {}\n", mrb_header->magic);
+			return false;
+		}
+
+		LOG_TO(log, logging::ELevel::Info, "Mrb entries {}\n", mrb_header->animation_count);
+
+		if (clip_names.empty())
+		{
+			mrb::AnimationIndex animation_index(mrb_header);
+			auto animation_count = static_cast<int>(animation_index.GetAnimationCount());
+			for (int animation_idx = 0; animation_idx < animation_count; animation_idx++)
+			{
+				BuildAnimationClip(animation_index.GetAnimation(animation_idx), skeleton, clips, log);
+			}
+		}
+		else if (clip_names.size() == 1)
+		{
+			// a single name only walks the headers in front of its animation
+			mrb::AnimationBlocks animation;
+			if (mrb::AnimationIndex::FindAnimation(mrb_header, clip_names[0], animation))
+			{
+				BuildAnimationClip(animation, skeleton, clips, log);
+			}
+			else
+			{
+				LOG_TO(log, logging::ELevel::Warning, "Animation '{}' not found\n", clip_names[0]);
+			}
+		}
+		else
+		{
+			// several names share one walk, then every lookup is a hash probe
+			mrb::AnimationIndex animation_index(mrb_header);
+			for (auto&& clip_name : clip_names)
+			{
+				auto animation = animation_index.FindAnimation(clip_name);
+				if (!animation)
+				{
+					LOG_TO(log, logging::ELevel::Warning, "Animation '{}' not found\n", clip_name);
+					continue;
+				}
+				BuildAnimationClip(*animation, skeleton, clips, log);
+			}
+		}
+
+		return true;
+	}
+
+	void ReduceKeys(AnimationClip& clip, const KeyReductionSettings& settings)
+	{
+		if (settings.mode == EKeyReduction::None || clip.key_times.empty())
+		{
+			return;
+		}
+
+		auto key_count = clip.key_times.size();
+		for (auto&& track : clip.tracks)
+		{
+			assert(track.translation_keys.empty() && track.rotation_keys.empty() && track.scale_keys.empty());
+
+			std::vector<uint32_t> translation_keys;
+			std::vector<uint32_t> rotation_keys;
+			std::vector<uint32_t> scale_keys;
+			if (settings.mode == EKeyReduction::Lossless)
+			{
+				translation_keys = DropRepeatedKeys(key_count, [&](size_t a, size_t b)
+				{
+					return SameSample(track.translations[a], track.translations[b]);
+				});
+				// exporters pick either representation, both have to repeat
+				rotation_keys = DropRepeatedKeys(key_count, [&](size_t a, size_t b)
+				{
+					return SameSample(track.rotations[a], track.rotations[b]) && SameSample(track.euler_rotations[a], track.euler_rotations[b]);
+				});
+				scale_keys = DropRepeatedKeys(key_count, [&](size_t a, size_t b)
+				{
+					return SameSample(track.scales[a], track.scales[b]);
+				});
+			}
+			else
+			{
+				translation_keys = FitLinearKeys(clip.key_times, track.translations, settings.translation_tolerance);
+				// FBX lerps the euler curves and glTF slerps the quaternions between the same keys, both have to fit
+				auto tolerance = settings.rotation_tolerance;
+				auto constant = IsConstant(track.euler_rotations, tolerance) && IsConstant(track.rotations, tolerance);
+				rotation_keys = FitLinearKeys(key_count, constant, [&](size_t first, size_t last)
+				{
+					return FitsSegment(clip.key_times, track.euler_rotations, first, last, tolerance) &&
+						FitsSlerpSegment(clip.key_times, track.rotations, first, last, tolerance);
+				});
+				scale_keys = FitLinearKeys(clip.key_times, track.scales, settings.scale_tolerance);
+			}
+
+			// a channel keeping every key stays as it is, with an empty key list
+			if (translation_keys.size() < key_count)
+			{
+				KeepSamples(translation_keys, track.translations);
+				track.translation_keys = std::move(translation_keys);
+			}
+			if (rotation_keys.size() < key_count)
+			{
+				KeepSamples(rotation_keys, track.rotations);
+				KeepSamples(rotation_keys, track.euler_rotations);
+				track.rotation_keys = std::move(rotation_keys);
+			}
+			if (scale_keys.size() < key_count)
+			{
+				KeepSamples(scale_keys, track.scales);
+				track.scale_keys = std::move(scale_keys);
+			}
+		}
+	}
+}
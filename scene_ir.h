@@ -0,0 +1,125 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+#include <string_view>
+
+#include "common.h"
+#include "dxg.h"
+#include "log.h"
+#include "skeleton.h"
+
+// Format neutral scene sitting between the DXG/MRB overlays and the exporters.
+// Plain float/uint32 streams, no FBX SDK types, so it builds and runs without the SDK.
+namespace ir
+{
+	// One DXG mesh group, vertices of all its meshes concatenated in file order
+	struct MeshGroup
+	{
+		// points into the DXG file data, null terminated
+		std::string_view name;
+		// false for DXG versions without a mesh parser, the group is still exported as an empty node
+		bool has_geometry = false;
+		bool has_uvs_2 = false;
+		bool has_colors = false;
+
+		std::vector<Vector3> positions;
+		std::vector<Vector3> normals;
+		// as stored in DXG, v axis pointing down
+		std::vector<Vector2> uvs;
+		// empty unless has_uvs_2
+		std::vector<Vector2> uvs_2;
+		// empty unless has_colors, vertices of meshes without colors are opaque white
+		std::vector<ColorRGBA> colors;
+
+		// triangle list into the group vertices
+		std::vector<uint32_t> indices;
+
+		// 3 influences per vertex, joints are skeleton bones (topological index).
+		// Unused influences and unskinned vertices have weight 0.
+		std::vector<uint16_t> joints;
+		std::vector<float> weights;
+		// bones influencing the group in first use order
+		std::vector<int> skin_bones;
+
+		size_t GetVertexCount() const
+		{
+			return positions.size();
+		}
+	};
+
+	// Samples of one bone, one per clip key time unless the channel was reduced
+	struct BoneTrack
+	{
+		// skeleton bone (topological index)
+		int bone;
+		std::vector<Vector3> translations;
+		// quaternions (x, y, z, w) as stored in MRB, signs flipped so consecutive keys share a hemisphere
+		std::vector<Vector4> rotations;
+		// the same rotations as XYZ euler angles in degrees (FbxAMatrix::GetR), made continuous by kernels::UnrollEulerAngles
+		std::vector<Vector3> euler_rotations;
+		std::vector<Vector3> scales;
+
+		// indices into the clip key times of the samples kept by ReduceKeys, empty if the channel has every key.
+		// rotation_keys covers both rotations and euler_rotations.
+		std::vector<uint32_t> translation_keys;
+		std::vector<uint32_t> rotation_keys;
+		std::vector<uint32_t> scale_keys;
+	};
+
+	struct AnimationClip
+	{
+		std::string name;
+		// milliseconds, shared by every track
+		std::vector<uint32_t> key_times;
+		std::vector<BoneTrack> tracks;
+	};
+
+	// Clips taken from one MRB file
+	struct AnimationSet
+	{
+		std::string name;
+		// clips go into the model's output instead of an output of their own
+		bool inline_ = false;
+		std::vector<AnimationClip> clips;
+	};
+
+	enum class EKeyReduction
+	{
+		None,
+		// drops keys repeating both neighbours and collapses constant channels, the curves stay exactly the same
+		Lossless,
+		// drops every key linear interpolation of the kept ones reproduces within the channel tolerance
+		Lossy
+	};
+
+	struct KeyReductionSettings
+	{
+		EKeyReduction mode = EKeyReduction::None;
+		// largest per component deviation, in units, degrees of euler_rotations and scale factor.
+		// Rotations also keep the slerp of the kept quaternions within rotation_tolerance degrees of every sample.
+		float translation_tolerance = 0.001f;
+		float rotation_tolerance = 0.01f;
+		float scale_tolerance = 0.0001f;
+	};
+
+	struct Scene
+	{
+		Skeleton skeleton;
+		std::vector<MeshGroup> mesh_groups;
+		std::vector<AnimationSet> animation_sets;
+	};
+
+	// One entry per DXG mesh group, throws std::logic_error if a mesh is influenced by a bone the skeleton doesn't have.
+	// Group data blocks are decoded on thread_count threads (0 for one per core), the result doesn't depend on it.
+	std::vector<MeshGroup> BuildMeshGroups(const dxg::FileHeader* file_header, const Skeleton& skeleton, unsigned thread_count = 0);
+
+	// Appends the clips of an MRB file, all of them if clip_names is empty. False if the file is not a valid MRB.
+	// Messages go into log, so concurrent export jobs each keep their lines together.
+	bool BuildAnimationClips(std::span<const uint8_t> file, const Skeleton& skeleton, std::span<const std::string> clip_names,
+		std::vector<AnimationClip>& clips, logging::Buffer& log);
+
+	// Drops redundant keys from every channel of an unreduced clip, a constant channel ends up with its first key only.
+	// The kept samples stay in key order and their clip key indices go into the channel's key list.
+	void ReduceKeys(AnimationClip& clip, const KeyReductionSettings& settings);
+}
@@ -0,0 +1,263 @@
+#include "skeleton.h"
+
+#include <cmath>
+#include <cassert>
+#include <numbers>
+
+#include "kernels.h"
+
+namespace
+{
+	// rows are the rotated basis vectors, i.e. the transpose of the column vector rotation matrix
+	Vector4 RotationToQuaternion(const float (&rows)[3][3])
+	{
+		Vector4 q;
+		auto trace = rows[0][0] + rows[1][1] + rows[2][2];
+		if (trace > 0.f)
+		{
+			auto s = std::sqrt(trace + 1.f) * 2.f;
+			q.w = 0.25f * s;
+			q.x = (rows[1][2] - rows[2][1]) / s;
+			q.y = (rows[2][0] - rows[0][2]) / s;
+			q.z = (rows[0][1] - rows[1][0]) / s;
+		}
+		else if (rows[0][0] > rows[1][1] && rows[0][0] > rows[2][2])
+		{
+			auto s = std::sqrt(1.f + rows[0][0] - rows[1][1] - rows[2][2]) * 2.f;
+			q.w = (rows[1][2] - rows[2][1]) / s;
+			q.x = 0.25f * s;
+			q.y = (rows[1][0] + rows[0][1]) / s;
+			q.z = (rows[2][0] + rows[0][2]) / s;
+		}
+		else if (rows[1][1] > rows[2][2])
+		{
+			auto s = std::sqrt(1.f + rows[1][1] - rows[0][0] - rows[2][2]) * 2.f;
+			q.w = (rows[2][0] - rows[0][2]) / s;
+			q.x = (rows[1][0] + rows[0][1]) / s;
+			q.y = 0.25f * s;
+			q.z = (rows[2][1] + rows[1][2]) / s;
+		}
+		else
+		{
+			auto s = std::sqrt(1.f + rows[2][2] - rows[0][0] - rows[1][1]) * 2.f;
+			q.w = (rows[0][1] - rows[1][0]) / s;
+			q.x = (rows[2][0] + rows[0][2]) / s;
+			q.y = (rows[2][1] + rows[1][2]) / s;
+			q.z = 0.25f * s;
+		}
+		return q;
+	}
+
+	// same decomposition FbxAMatrix does for GetT/GetR/GetS, rotation as XYZ euler in degrees and as a quaternion
+	void DecomposeMatrix(const Matrix4x4& matrix, Vector3& translation, Vector3& rotation, Vector4& quaternion, Vector3& scale)
+	{
+		translation = { matrix.m[3][0], matrix.m[3][1], matrix.m[3][2] };
+
+		float rows[3][3];
+		for (int row = 0; row < 3; row++)
+		{
+			auto x = matrix.m[row][0];
+			auto y = matrix.m[row][1];
+			auto z = matrix.m[row][2];
+			scale.raw[row] = std::sqrt(x * x + y * y + z * z);
+
+			auto inv_length = scale.raw[row] != 0.f ? 1.f / scale.raw[row] : 0.f;
+			rows[row][0] = x * inv_length;
+			rows[row][1] = y * inv_length;
+			rows[row][2] = z * inv_length;
+		}
+
+		auto determinant =
+			rows[0][0] * (rows[1][1] * rows[2][2] - rows[1][2] * rows[2][1]) -
+			rows[0][1] * (rows[1][0] * rows[2][2] - rows[1][2] * rows[2][0]) +
+			rows[0][2] * (rows[1][0] * rows[2][1] - rows[1][1] * rows[2][0]);
+		if (determinant < 0.f)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				scale.raw[row] = -scale.raw[row];
+				rows[row][0] = -rows[row][0];
+				rows[row][1] = -rows[row][1];
+				rows[row][2] = -rows[row][2];
+			}
+		}
+
+		quaternion = RotationToQuaternion(rows);
+
+		constexpr auto to_degrees = 180.f / std::numbers::pi_v<float>;
+
+		// rows are the rotated basis vectors, R = Rz * Ry * Rx
+		auto sin_y = std::fmax(-1.f, std::fmin(1.f, -rows[0][2]));
+		if (std::fabs(sin_y) < 0.99999f)
+		{
+			rotation.x = std::atan2(rows[1][2], rows[2][2]) * to_degrees;
+			rotation.y = std::asin(sin_y) * to_degrees;
+			rotation.z = std::atan2(rows[0][1], rows[0][0]) * to_degrees;
+		}
+		else
+		{
+			// gimbal lock, fold z into x
+			rotation.x = std::atan2(-rows[2][1], rows[1][1]) * to_degrees;
+			rotation.y = std::asin(sin_y) * to_degrees;
+			rotation.z = 0.f;
+		}
+	}
+
+	// 16 float streams, one per matrix element
+	struct MatrixStreamStorage
+	{
+		explicit MatrixStreamStorage(size_t count)
+		{
+			for (auto& stream : elements)
+			{
+				stream.resize(count);
+			}
+		}
+
+		kernels::MatrixStreams Get()
+		{
+			kernels::MatrixStreams result;
+			for (int e = 0; e < 16; e++)
+			{
+				result[e] = elements[e].data();
+			}
+			return result;
+		}
+
+		kernels::ConstMatrixStreams GetConst() const
+		{
+			kernels::ConstMatrixStreams result;
+			for (int e = 0; e < 16; e++)
+			{
+				result[e] = elements[e].data();
+			}
+			return result;
+		}
+
+		void Set(size_t index, const Matrix4x4& matrix)
+		{
+			for (int e = 0; e < 16; e++)
+			{
+				elements[e][index] = matrix.raw[e];
+			}
+		}
+
+		Matrix4x4 Get(size_t index) const
+		{
+			Matrix4x4 matrix;
+			for (int e = 0; e < 16; e++)
+			{
+				matrix.raw[e] = elements[e][index];
+			}
+			return matrix;
+		}
+
+		std::vector<float> elements[16];
+	};
+}
+
+Skeleton::Skeleton(const dxg::SkeletonHeader* header)
+{
+	auto bone_names = header->GetBoneNames()->Parse();
+	auto links = header->GetBoneLinks();
+	auto matrices = header->GetBoneMatrices();
+
+	assert(bone_names.size() == links.size());
+	assert(bone_names.size() == matrices.size());
+
+	// bones are addressed with int8 links, so int indices throughout
+	auto bone_count = static_cast<int>(links.size());
+	auto name_count = static_cast<int>(bone_names.size());
+
+	// breadth first from the roots, children keep their DXG order
+	std::vector<std::vector<int>> children(bone_count);
+	std::vector<int> roots;
+	for (int i = 0; i < bone_count; i++)
+	{
+		auto parent = links[i].parent;
+		if (parent >= 0 && parent < bone_count && parent != i)
+		{
+			children[parent].push_back(i);
+		}
+		else
+		{
+			roots.push_back(i);
+		}
+	}
+
+	source_indices.reserve(bone_count);
+	topological_indices.assign(bone_count, -1);
+	for (auto root : roots)
+	{
+		auto first = source_indices.size();
+		source_indices.push_back(root);
+		topological_indices[root] = static_cast<int>(first);
+		for (auto next = first; next < source_indices.size(); next++)
+		{
+			for (auto child : children[source_indices[next]])
+			{
+				topological_indices[child] = static_cast<int>(source_indices.size());
+				source_indices.push_back(child);
+			}
+		}
+	}
+	// bones stuck in a parent cycle are never reached from a root, keep them as roots
+	for (int i = 0; i < bone_count; i++)
+	{
+		if (topological_indices[i] == -1)
+		{
+			topological_indices[i] = static_cast<int>(source_indices.size());
+			source_indices.push_back(i);
+		}
+	}
+
+	names.resize(bone_count);
+	parents.resize(bone_count);
+	inverse_bind_matrices.resize(bone_count);
+	bone_indices.reserve(bone_count);
+	for (int bone = 0; bone < bone_count; bone++)
+	{
+		auto source = source_indices[bone];
+		names[bone] = source < name_count ? bone_names[source] : std::string_view();
+		bone_indices.emplace(names[bone], bone);
+		inverse_bind_matrices[bone] = matrices[source];
+
+		auto parent = links[source].parent;
+		parents[bone] = parent >= 0 && parent < bone_count && parent != source ? topological_indices[parent] : -1;
+		// a cycle member promoted to root must not point back into the cycle
+		if (parents[bone] >= bone)
+		{
+			parents[bone] = -1;
+		}
+	}
+
+	// global = inverse(inverse_bind), local = global * inverse_bind(parent)
+	Matrix4x4 identity;
+	identity.m[0][0] = identity.m[1][1] = identity.m[2][2] = identity.m[3][3] = 1.f;
+
+	MatrixStreamStorage inverse_bind(bone_count);
+	MatrixStreamStorage parent_inverse_bind(bone_count);
+	MatrixStreamStorage global_bind(bone_count);
+	MatrixStreamStorage local(bone_count);
+	for (int bone = 0; bone < bone_count; bone++)
+	{
+		inverse_bind.Set(bone, inverse_bind_matrices[bone]);
+		parent_inverse_bind.Set(bone, parents[bone] >= 0 ? inverse_bind_matrices[parents[bone]] : identity);
+	}
+
+	kernels::InvertMatrices(inverse_bind.GetConst(), global_bind.Get(), bone_count);
+	kernels::MultiplyMatrices(global_bind.GetConst(), parent_inverse_bind.GetConst(), local.Get(), bone_count);
+
+	global_bind_matrices.resize(bone_count);
+	local_matrices.resize(bone_count);
+	local_translations.resize(bone_count);
+	local_rotations.resize(bone_count);
+	local_quaternions.resize(bone_count);
+	local_scales.resize(bone_count);
+	for (int bone = 0; bone < bone_count; bone++)
+	{
+		global_bind_matrices[bone] = global_bind.Get(bone);
+		local_matrices[bone] = local.Get(bone);
+		DecomposeMatrix(local_matrices[bone], local_translations[bone], local_rotations[bone], local_quaternions[bone], local_scales[bone]);
+	}
+}
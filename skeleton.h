@@ -0,0 +1,57 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+#include "dxg.h"
+
+// Structure of arrays view of a DXG skeleton with its bind pose solved in one batch.
+// Bones are stored in topological order (parents before children),
+// matrices use the DXG/FbxAMatrix row layout with translation in the last row.
+struct Skeleton
+{
+	Skeleton() = default;
+	explicit Skeleton(const dxg::SkeletonHeader* header);
+
+	size_t GetBoneCount() const
+	{
+		return names.size();
+	}
+
+	// bone index in the DXG skeleton -> topological index
+	int GetBoneIndex(int source_index) const
+	{
+		return topological_indices[source_index];
+	}
+
+	// topological index of a bone by name, -1 if there is no such bone
+	int FindBone(std::string_view name) const
+	{
+		auto it = bone_indices.find(name);
+		return it != bone_indices.end() ? it->second : -1;
+	}
+
+	std::vector<std::string_view> names;
+	// topological index of the parent, -1 for roots
+	std::vector<int> parents;
+	// bone index in the DXG skeleton
+	std::vector<int> source_indices;
+	std::vector<int> topological_indices;
+	// names point into the DXG file data
+	std::unordered_map<std::string_view, int> bone_indices;
+
+	// DXG bone matrices, world -> bone
+	std::vector<Matrix4x4> inverse_bind_matrices;
+	// bone -> world, what FbxCluster expects as the transform link matrix
+	std::vector<Matrix4x4> global_bind_matrices;
+	// bone -> parent
+	std::vector<Matrix4x4> local_matrices;
+
+	// local_matrices decomposed like FbxAMatrix::GetT/GetR/GetS, rotations are XYZ euler angles in degrees
+	std::vector<Vector3> local_translations;
+	std::vector<Vector3> local_rotations;
+	// same rotations as (x, y, z, w) quaternions
+	std::vector<Vector4> local_quaternions;
+	std::vector<Vector3> local_scales;
+};
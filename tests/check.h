@@ -0,0 +1,61 @@
+#pragma once
+#include <cmath>
+#include <format>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <string_view>
+#include <filesystem>
+
+// Bare bones assertions for the test executables. A failed check is reported and the test carries on,
+// main returns check::Result() so ctest sees every failure of a run at once.
+namespace check
+{
+	inline int failures = 0;
+
+	inline void Fail(std::string_view expression, std::string_view file, int line)
+	{
+		failures++;
+		std::cerr << std::format("{}({}): check failed: {}\n", file, line, expression);
+	}
+
+	inline bool Near(float a, float b, float tolerance = 1e-5f)
+	{
+		return std::abs(a - b) <= tolerance;
+	}
+
+	// per test scratch folder under the system temp folder, emptied on creation
+	inline std::filesystem::path MakeTempFolder(std::string_view name)
+	{
+		auto folder = std::filesystem::temp_directory_path() / "dxg_tests" / name;
+		std::filesystem::remove_all(folder);
+		std::filesystem::create_directories(folder);
+		return folder;
+	}
+
+	inline std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+	}
+
+	inline int Result()
+	{
+		if (failures)
+		{
+			std::cerr << std::format("{} checks failed\n", failures);
+		}
+		return failures ? 1 : 0;
+	}
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			::check::Fail(#condition, __FILE__, __LINE__); \
+		} \
+	} while (false)
@@ -0,0 +1,336 @@
+#include <string>
+#include <vector>
+#include <format>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "check.h"
+#include "../dxg.h"
+#include "../fbx_writer.h"
+#include "../fixtures.h"
+#include "../log.h"
+#include "../mapped_file.h"
+#include "../scene_ir.h"
+#include "../skeleton.h"
+
+// fbx::WriteFbx output read back record by record: end offsets, null records, array encodings and the footer,
+// for the 32 bit 7400 and the 64 bit 7500 layout
+namespace
+{
+	constexpr char HEADER_MAGIC[] = "Kaydara FBX Binary  \x00\x1a\x00";
+	constexpr size_t HEADER_SIZE = sizeof(HEADER_MAGIC) - 1 + 4;
+	constexpr uint8_t FOOTER_MAGIC[16] = { 0xf8, 0x5a, 0x8c, 0x6a, 0xde, 0xf5, 0xd9, 0x7e, 0xec, 0xe9, 0x0c, 0xe3, 0x75, 0x8f, 0x29, 0x0b };
+
+	// Walks a whole file, any record that doesn't add up is a failed check
+	class Reader
+	{
+	public:
+		explicit Reader(std::vector<uint8_t> file)
+			: _file(std::move(file))
+		{
+		}
+
+		// names of every record in file order, nesting marked with '/'
+		std::vector<std::string> names;
+		size_t array_count = 0;
+		size_t deflated_count = 0;
+		// the footer started on a 16 byte boundary and took the full 16 bytes of padding
+		bool full_footer_padding = false;
+
+		void Read()
+		{
+			if (!Fits(HEADER_SIZE) || std::memcmp(_file.data(), HEADER_MAGIC, sizeof(HEADER_MAGIC) - 1) != 0)
+			{
+				check::Fail("header magic", __FILE__, __LINE__);
+				return;
+			}
+			_version = Get<uint32_t>(sizeof(HEADER_MAGIC) - 1);
+			CHECK(_version == 7400 || _version == 7500);
+
+			size_t offset = HEADER_SIZE;
+			while (!IsNullRecord(offset))
+			{
+				auto end = ReadNode(offset, "");
+				if (end <= offset)
+				{
+					return;
+				}
+				offset = end;
+			}
+			ReadFooter(offset + GetRecordHeaderSize());
+		}
+
+		uint32_t GetVersion() const
+		{
+			return _version;
+		}
+
+	private:
+		std::vector<uint8_t> _file;
+		uint32_t _version = 0;
+
+		bool IsWide() const
+		{
+			return _version >= 7500;
+		}
+
+		size_t GetRecordHeaderSize() const
+		{
+			return IsWide() ? 25 : 13;
+		}
+
+		bool Fits(size_t end) const
+		{
+			return end <= _file.size();
+		}
+
+		template<class T>
+		T Get(size_t offset) const
+		{
+			T value{};
+			if (offset + sizeof(T) <= _file.size())
+			{
+				std::memcpy(&value, _file.data() + offset, sizeof(T));
+			}
+			return value;
+		}
+
+		bool IsNullRecord(size_t offset) const
+		{
+			if (offset + GetRecordHeaderSize() > _file.size())
+			{
+				return false;
+			}
+			auto record = _file.begin() + offset;
+			return std::all_of(record, record + GetRecordHeaderSize(), [](uint8_t byte) { return byte == 0; });
+		}
+
+		// returns the end offset of the record, 0 if it is broken
+		size_t ReadNode(size_t offset, const std::string& parent)
+		{
+			uint64_t end, property_count, properties_size;
+			if (IsWide())
+			{
+				end = Get<uint64_t>(offset);
+				property_count = Get<uint64_t>(offset + 8);
+				properties_size = Get<uint64_t>(offset + 16);
+			}
+			else
+			{
+				end = Get<uint32_t>(offset);
+				property_count = Get<uint32_t>(offset + 4);
+				properties_size = Get<uint32_t>(offset + 8);
+			}
+			auto name_size = Get<uint8_t>(offset + GetRecordHeaderSize() - 1);
+			auto name_offset = offset + GetRecordHeaderSize();
+			if (end <= name_offset || !Fits(end))
+			{
+				check::Fail("record end offset", __FILE__, __LINE__);
+				return 0;
+			}
+			auto name = parent + std::string(reinterpret_cast<const char*>(_file.data() + name_offset), name_size);
+			names.push_back(name);
+
+			auto properties_offset = name_offset + name_size;
+			auto cursor = properties_offset;
+			for (uint64_t i = 0; i < property_count && cursor < end; i++)
+			{
+				cursor = ReadProperty(cursor);
+			}
+			CHECK(cursor == properties_offset + properties_size);
+			if (cursor != properties_offset + properties_size)
+			{
+				return 0;
+			}
+
+			// children, then a null record closing them; a childless record may have one too
+			while (cursor < end && !IsNullRecord(cursor))
+			{
+				auto child_end = ReadNode(cursor, name + "/");
+				if (child_end <= cursor)
+				{
+					return 0;
+				}
+				cursor = child_end;
+			}
+			if (cursor < end)
+			{
+				CHECK(cursor + GetRecordHeaderSize() == end);
+				cursor += GetRecordHeaderSize();
+			}
+			CHECK(cursor == end);
+			return end;
+		}
+
+		size_t ReadProperty(size_t offset)
+		{
+			auto type = static_cast<char>(Get<uint8_t>(offset++));
+			switch (type)
+			{
+			case 'C': return offset + 1;
+			case 'Y': return offset + 2;
+			case 'I': case 'F': return offset + 4;
+			case 'L': case 'D': return offset + 8;
+			case 'S': case 'R': return offset + 4 + Get<uint32_t>(offset);
+			case 'f': case 'i': return ReadArray(offset, 4);
+			case 'd': case 'l': return ReadArray(offset, 8);
+			}
+			check::Fail(std::format("property type '{}'", type), __FILE__, __LINE__);
+			return _file.size();
+		}
+
+		// a deflated array has to inflate to exactly count elements
+		size_t ReadArray(size_t offset, size_t element_size)
+		{
+			auto count = Get<uint32_t>(offset);
+			auto encoding = Get<uint32_t>(offset + 4);
+			auto size = Get<uint32_t>(offset + 8);
+			offset += 12;
+			if (!Fits(offset + size))
+			{
+				check::Fail("array past the end of the file", __FILE__, __LINE__);
+				return _file.size();
+			}
+
+			array_count++;
+			auto expected_size = count * element_size;
+			if (encoding == 0)
+			{
+				CHECK(size == expected_size);
+			}
+			else
+			{
+				CHECK(encoding == 1);
+				deflated_count++;
+				// one spare byte so a longer stream shows up as a size mismatch instead of Z_BUF_ERROR
+				std::vector<uint8_t> inflated(expected_size + 1);
+				uLongf inflated_size = static_cast<uLongf>(inflated.size());
+				auto status = uncompress(inflated.data(), &inflated_size, _file.data() + offset, size);
+				CHECK(status == Z_OK);
+				CHECK(inflated_size == expected_size);
+			}
+			return offset + size;
+		}
+
+		// footer id, 4 zero bytes, zeros up to the next 16 byte boundary (16 if already there), version,
+		// 120 zero bytes and the footer magic, then the end of the file
+		void ReadFooter(size_t offset)
+		{
+			offset += 16 + 4;
+			auto padding = ((offset + 15) & ~size_t(15)) - offset;
+			full_footer_padding = padding == 0;
+			offset += padding ? padding : 16;
+			CHECK(offset % 16 == 0);
+			CHECK(Get<uint32_t>(offset) == _version);
+			offset += 4 + 120;
+			CHECK(offset + sizeof(FOOTER_MAGIC) == _file.size());
+			CHECK(Fits(offset + sizeof(FOOTER_MAGIC)) && std::memcmp(_file.data() + offset, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) == 0);
+		}
+	};
+
+	Reader ReadFbx(const std::filesystem::path& path, uint32_t version)
+	{
+		Reader reader(check::ReadFile(path));
+		reader.Read();
+		CHECK(reader.GetVersion() == version);
+		return reader;
+	}
+
+	void TestWriteFbx(const fixtures::Parameters& parameters, std::string_view name)
+	{
+		auto folder = check::MakeTempFolder(name);
+		fixtures::WriteDxg(folder / "fixture.dxg", parameters);
+		fixtures::WriteMrb(folder / "fixture.mrb", parameters);
+
+		MappedFile dxg_file(folder / "fixture.dxg");
+		auto file_header = reinterpret_cast<const dxg::FileHeader*>(dxg_file.data());
+		Skeleton skeleton(file_header->GetSkeletonHeader());
+		auto groups = ir::BuildMeshGroups(file_header, skeleton, 1);
+
+		MappedFile mrb_file(folder / "fixture.mrb");
+		logging::Buffer log;
+		std::vector<ir::AnimationClip> clips;
+		CHECK(ir::BuildAnimationClips(mrb_file.GetData(), skeleton, {}, clips, log));
+		log.Flush();
+
+		fbx::WriteFbx(folder / "7400.fbx", skeleton, groups, clips, 7400, 1);
+		fbx::WriteFbx(folder / "7500.fbx", skeleton, groups, clips, 7500, 2);
+		auto narrow = ReadFbx(folder / "7400.fbx", 7400);
+		auto wide = ReadFbx(folder / "7500.fbx", 7500);
+
+		// same document whatever the record width
+		CHECK(narrow.names == wide.names);
+		CHECK(narrow.array_count == wide.array_count);
+		CHECK(narrow.deflated_count == wide.deflated_count);
+		CHECK(narrow.array_count > 0);
+		CHECK(narrow.deflated_count > 0);
+		for (auto section : { "FBXHeaderExtension", "GlobalSettings", "Definitions", "Objects", "Connections", "Takes" })
+		{
+			CHECK(std::ranges::find(narrow.names, section) != narrow.names.end());
+		}
+		CHECK(std::ranges::count(narrow.names, "Objects/Geometry") == parameters.groups);
+		CHECK(std::ranges::count(narrow.names, "Objects/AnimationStack") == parameters.clips);
+
+		// a model per bone and per mesh group, plus the root
+		CHECK(std::ranges::count(narrow.names, "Objects/Model") == parameters.bones + parameters.groups + 1);
+	}
+
+	// the padding rule only differs on an already aligned footer, tiny scenes with different seeds
+	// compress to different sizes until one lands there
+	void TestFooterPadding()
+	{
+		auto folder = check::MakeTempFolder("fbx_footer");
+		fixtures::Parameters parameters;
+		parameters.groups = 1;
+		parameters.blocks = 1;
+		parameters.meshes = 1;
+		parameters.vertices = 100;
+		parameters.faces = 100;
+		parameters.bones = 4;
+		parameters.clips = 0;
+
+		bool found = false;
+		for (uint32_t seed = 1; seed <= 64 && !found; seed++)
+		{
+			parameters.seed = seed;
+			fixtures::WriteDxg(folder / "fixture.dxg", parameters);
+			MappedFile dxg_file(folder / "fixture.dxg");
+			auto file_header = reinterpret_cast<const dxg::FileHeader*>(dxg_file.data());
+			Skeleton skeleton(file_header->GetSkeletonHeader());
+			auto groups = ir::BuildMeshGroups(file_header, skeleton, 1);
+			fbx::WriteFbx(folder / "footer.fbx", skeleton, groups, {}, 7400, 1);
+			found = ReadFbx(folder / "footer.fbx", 7400).full_footer_padding;
+		}
+		CHECK(found);
+	}
+}
+
+int main()
+{
+	logging::SetLevel(logging::ELevel::Warning);
+
+	fixtures::Parameters parameters;
+	parameters.groups = 2;
+	parameters.meshes = 3;
+	parameters.vertices = 120;
+	parameters.faces = 150;
+	parameters.bones = 12;
+	parameters.clips = 2;
+	parameters.keyframes = 40;
+	TestWriteFbx(parameters, "fbx_skinned");
+
+	// no weights, second uv set, colors or clips
+	fixtures::Parameters plain = parameters;
+	plain.weight_bones = 0;
+	plain.uvs_2 = false;
+	plain.colors = false;
+	plain.clips = 0;
+	TestWriteFbx(plain, "fbx_plain");
+	TestFooterPadding();
+
+	logging::Flush();
+	return check::Result();
+}
@@ -0,0 +1,450 @@
+#include <span>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+#include "check.h"
+#include "../dxg.h"
+#include "../fixtures.h"
+#include "../gltf_writer.h"
+#include "../log.h"
+#include "../mapped_file.h"
+#include "../scene_ir.h"
+#include "../skeleton.h"
+
+// gltf::WriteGlb output read back: GLB header and chunks, every buffer view and accessor against the BIN chunk,
+// and the vertex data behind the accessors
+namespace
+{
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;
+	constexpr uint32_t CHUNK_TYPE_JSON = 0x4E4F534A;
+	constexpr uint32_t CHUNK_TYPE_BIN = 0x004E4942;
+
+	// Just enough JSON for the writer's output, a parse error is a failed check
+	struct Json
+	{
+		enum class EType
+		{
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		EType type = EType::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<Json> items;
+		std::vector<std::pair<std::string, Json>> members;
+
+		// a null value when missing, so lookups can be chained
+		const Json& operator[](std::string_view key) const
+		{
+			static const Json missing;
+			auto it = std::ranges::find(members, key, &std::pair<std::string, Json>::first);
+			return it == members.end() ? missing : it->second;
+		}
+
+		const Json& operator[](size_t index) const
+		{
+			static const Json missing;
+			return index < items.size() ? items[index] : missing;
+		}
+
+		bool Has(std::string_view key) const
+		{
+			return std::ranges::find(members, key, &std::pair<std::string, Json>::first) != members.end();
+		}
+
+		size_t AsSize() const
+		{
+			return static_cast<size_t>(number);
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		explicit JsonParser(std::string_view text)
+			: _text(text)
+		{
+		}
+
+		Json Parse()
+		{
+			auto value = ParseValue();
+			SkipSpaces();
+			CHECK(_position == _text.size());
+			return value;
+		}
+
+	private:
+		std::string_view _text;
+		size_t _position = 0;
+
+		void SkipSpaces()
+		{
+			while (_position < _text.size() && std::strchr(" \t\r\n", _text[_position]))
+			{
+				_position++;
+			}
+		}
+
+		bool Consume(char c)
+		{
+			SkipSpaces();
+			if (_position < _text.size() && _text[_position] == c)
+			{
+				_position++;
+				return true;
+			}
+			return false;
+		}
+
+		void Expect(char c)
+		{
+			if (!Consume(c))
+			{
+				check::Fail(std::format("'{}' at {} of the JSON chunk", c, _position), __FILE__, __LINE__);
+				_position = _text.size();
+			}
+		}
+
+		std::string ParseString()
+		{
+			Expect('"');
+			std::string result;
+			while (_position < _text.size() && _text[_position] != '"')
+			{
+				if (_text[_position] == '\\' && _position + 1 < _text.size())
+				{
+					_position++;
+					if (_text[_position] == 'u')
+					{
+						unsigned code = 0;
+						std::from_chars(_text.data() + _position + 1, _text.data() + std::min(_position + 5, _text.size()), code, 16);
+						result += static_cast<char>(code);
+						_position += 5;
+						continue;
+					}
+				}
+				result += _text[_position++];
+			}
+			Expect('"');
+			return result;
+		}
+
+		Json ParseValue()
+		{
+			Json value;
+			SkipSpaces();
+			if (_position >= _text.size())
+			{
+				check::Fail("value past the end of the JSON chunk", __FILE__, __LINE__);
+				return value;
+			}
+
+			auto c = _text[_position];
+			if (c == '{')
+			{
+				value.type = Json::EType::Object;
+				Expect('{');
+				if (!Consume('}'))
+				{
+					do
+					{
+						auto key = ParseString();
+						Expect(':');
+						value.members.emplace_back(std::move(key), ParseValue());
+					} while (Consume(','));
+					Expect('}');
+				}
+			}
+			else if (c == '[')
+			{
+				value.type = Json::EType::Array;
+				Expect('[');
+				if (!Consume(']'))
+				{
+					do
+					{
+						value.items.push_back(ParseValue());
+					} while (Consume(','));
+					Expect(']');
+				}
+			}
+			else if (c == '"')
+			{
+				value.type = Json::EType::String;
+				value.string = ParseString();
+			}
+			else if (_text.substr(_position, 4) == "true" || _text.substr(_position, 5) == "false")
+			{
+				value.type = Json::EType::Bool;
+				value.boolean = c == 't';
+				_position += value.boolean ? 4 : 5;
+			}
+			else if (_text.substr(_position, 4) == "null")
+			{
+				_position += 4;
+			}
+			else
+			{
+				value.type = Json::EType::Number;
+				auto [end, error] = std::from_chars(_text.data() + _position, _text.data() + _text.size(), value.number);
+				if (error != std::errc())
+				{
+					check::Fail(std::format("number at {} of the JSON chunk", _position), __FILE__, __LINE__);
+					_position = _text.size();
+				}
+				else
+				{
+					_position = end - _text.data();
+				}
+			}
+			return value;
+		}
+	};
+
+	template<class T>
+	T Get(std::span<const uint8_t> bytes, size_t offset)
+	{
+		T value{};
+		if (offset + sizeof(T) <= bytes.size())
+		{
+			std::memcpy(&value, bytes.data() + offset, sizeof(T));
+		}
+		return value;
+	}
+
+	size_t GetComponentCount(std::string_view type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT4") return 16;
+		check::Fail(std::format("accessor type '{}'", type), __FILE__, __LINE__);
+		return 0;
+	}
+
+	size_t GetComponentSize(size_t component_type)
+	{
+		switch (component_type)
+		{
+		case 5120: case 5121: return 1;
+		case 5122: case 5123: return 2;
+		case 5125: case 5126: return 4;
+		}
+		check::Fail(std::format("component type {}", component_type), __FILE__, __LINE__);
+		return 0;
+	}
+
+	struct Glb
+	{
+		std::vector<uint8_t> file;
+		Json json;
+		std::span<const uint8_t> binary;
+
+		// bytes behind an accessor, empty if it doesn't fit its buffer view
+		std::span<const uint8_t> GetAccessorData(size_t accessor_idx) const
+		{
+			auto& accessor = json["accessors"][accessor_idx];
+			auto& view = json["bufferViews"][accessor["bufferView"].AsSize()];
+			auto stride = GetComponentCount(accessor["type"].string) * GetComponentSize(accessor["componentType"].AsSize());
+			auto offset = view["byteOffset"].AsSize() + accessor["byteOffset"].AsSize();
+			auto size = accessor["count"].AsSize() * stride;
+			if (offset + size > binary.size())
+			{
+				return {};
+			}
+			return binary.subspan(offset, size);
+		}
+	};
+
+	// Header, chunk layout and every view and accessor bound
+	Glb ReadGlb(const std::filesystem::path& path)
+	{
+		Glb glb;
+		glb.file = check::ReadFile(path);
+		std::span<const uint8_t> file(glb.file);
+
+		CHECK(file.size() >= 20);
+		CHECK(Get<uint32_t>(file, 0) == GLB_MAGIC);
+		CHECK(Get<uint32_t>(file, 4) == 2);
+		CHECK(Get<uint32_t>(file, 8) == file.size());
+		CHECK(file.size() % 4 == 0);
+
+		auto json_size = Get<uint32_t>(file, 12);
+		CHECK(Get<uint32_t>(file, 16) == CHUNK_TYPE_JSON);
+		CHECK(json_size % 4 == 0);
+		if (20 + json_size > file.size())
+		{
+			check::Fail("JSON chunk past the end of the file", __FILE__, __LINE__);
+			return glb;
+		}
+		std::string_view json_text(reinterpret_cast<const char*>(file.data() + 20), json_size);
+		// padded with spaces, which the parser skips
+		glb.json = JsonParser(json_text).Parse();
+		CHECK(glb.json["asset"]["version"].string == "2.0");
+
+		auto binary_offset = 20 + json_size;
+		if (binary_offset == file.size())
+		{
+			CHECK(!glb.json.Has("buffers"));
+			return glb;
+		}
+		auto binary_size = Get<uint32_t>(file, binary_offset);
+		CHECK(Get<uint32_t>(file, binary_offset + 4) == CHUNK_TYPE_BIN);
+		CHECK(binary_size % 4 == 0);
+		CHECK(binary_offset + 8 + binary_size == file.size());
+		glb.binary = file.subspan(binary_offset + 8, std::min<size_t>(binary_size, file.size() - binary_offset - 8));
+
+		auto& buffers = glb.json["buffers"];
+		CHECK(buffers.items.size() == 1);
+		CHECK(buffers[0]["byteLength"].AsSize() == binary_size);
+
+		auto& views = glb.json["bufferViews"];
+		for (auto&& view : views.items)
+		{
+			CHECK(view["buffer"].AsSize() == 0);
+			CHECK(view["byteOffset"].AsSize() % 4 == 0);
+			CHECK(view["byteOffset"].AsSize() + view["byteLength"].AsSize() <= binary_size);
+		}
+
+		auto& accessors = glb.json["accessors"];
+		for (auto&& accessor : accessors.items)
+		{
+			auto view_idx = accessor["bufferView"].AsSize();
+			CHECK(view_idx < views.items.size());
+			auto& view = views[view_idx];
+			auto component_size = GetComponentSize(accessor["componentType"].AsSize());
+			auto stride = GetComponentCount(accessor["type"].string) * component_size;
+			CHECK(accessor["count"].AsSize() > 0);
+			CHECK(accessor["byteOffset"].AsSize() + accessor["count"].AsSize() * stride <= view["byteLength"].AsSize());
+			CHECK((view["byteOffset"].AsSize() + accessor["byteOffset"].AsSize()) % component_size == 0);
+		}
+		return glb;
+	}
+
+	template<class T>
+	bool SameData(std::span<const uint8_t> data, const std::vector<T>& values)
+	{
+		return data.size() == values.size() * sizeof(T) && (values.empty() || std::memcmp(data.data(), values.data(), data.size()) == 0);
+	}
+
+	void TestWriteGlb(const fixtures::Parameters& parameters, std::string_view name)
+	{
+		auto folder = check::MakeTempFolder(name);
+		fixtures::WriteDxg(folder / "fixture.dxg", parameters);
+		fixtures::WriteMrb(folder / "fixture.mrb", parameters);
+
+		MappedFile dxg_file(folder / "fixture.dxg");
+		auto file_header = reinterpret_cast<const dxg::FileHeader*>(dxg_file.data());
+		Skeleton skeleton(file_header->GetSkeletonHeader());
+		auto groups = ir::BuildMeshGroups(file_header, skeleton, 1);
+
+		MappedFile mrb_file(folder / "fixture.mrb");
+		logging::Buffer log;
+		std::vector<ir::AnimationClip> clips;
+		CHECK(ir::BuildAnimationClips(mrb_file.GetData(), skeleton, {}, clips, log));
+		log.Flush();
+
+		auto skinned = parameters.weight_bones > 0;
+		// every other vertex of the first group without influences, like an unskinned mesh merged into a skinned group
+		std::vector<size_t> unweighted;
+		if (skinned)
+		{
+			auto& group = groups.front();
+			for (size_t vertex = 0; vertex < group.GetVertexCount(); vertex += 2)
+			{
+				std::fill_n(group.weights.begin() + vertex * 3, 3, 0.f);
+				unweighted.push_back(vertex);
+			}
+		}
+
+		gltf::WriteGlb(folder / "output.glb", skeleton, groups, clips);
+		auto glb = ReadGlb(folder / "output.glb");
+
+		auto& meshes = glb.json["meshes"];
+		CHECK(meshes.items.size() == groups.size());
+		CHECK(glb.json["animations"].items.size() == (parameters.keyframes ? clips.size() : 0));
+		CHECK(glb.json.Has("skins") == (skeleton.GetBoneCount() > 0));
+		for (size_t group_idx = 0; group_idx < std::min(meshes.items.size(), groups.size()); group_idx++)
+		{
+			auto& group = groups[group_idx];
+			auto& primitive = meshes[group_idx]["primitives"][0];
+			auto& attributes = primitive["attributes"];
+			CHECK(SameData(glb.GetAccessorData(attributes["POSITION"].AsSize()), group.positions));
+			CHECK(SameData(glb.GetAccessorData(attributes["NORMAL"].AsSize()), group.normals));
+			CHECK(SameData(glb.GetAccessorData(primitive["indices"].AsSize()), group.indices));
+			CHECK(attributes.Has("TEXCOORD_1") == group.has_uvs_2);
+			CHECK(attributes.Has("COLOR_0") == group.has_colors);
+			CHECK(attributes.Has("JOINTS_0") == skinned);
+			if (!skinned)
+			{
+				continue;
+			}
+
+			// vec4 rows: the IR's 3 influences and a zero fourth, vertices without influences pinned to skin_bones.front()
+			auto joints = glb.GetAccessorData(attributes["JOINTS_0"].AsSize());
+			auto weights = glb.GetAccessorData(attributes["WEIGHTS_0"].AsSize());
+			CHECK(joints.size() == group.GetVertexCount() * 4 * sizeof(uint16_t));
+			CHECK(weights.size() == group.GetVertexCount() * 4 * sizeof(float));
+			if (joints.size() != group.GetVertexCount() * 4 * sizeof(uint16_t) || weights.size() != group.GetVertexCount() * 4 * sizeof(float))
+			{
+				continue;
+			}
+			for (size_t vertex = 0; vertex < group.GetVertexCount(); vertex++)
+			{
+				auto joint = [&](int j) { return Get<uint16_t>(joints, (vertex * 4 + j) * sizeof(uint16_t)); };
+				auto weight = [&](int j) { return Get<float>(weights, (vertex * 4 + j) * sizeof(float)); };
+				CHECK(weight(3) == 0.f);
+				if (group_idx == 0 && std::ranges::binary_search(unweighted, vertex))
+				{
+					CHECK(joint(0) == group.skin_bones.front());
+					CHECK(weight(0) == 1.f && weight(1) == 0.f && weight(2) == 0.f);
+					continue;
+				}
+				for (int j = 0; j < 3; j++)
+				{
+					CHECK(joint(j) == group.joints[vertex * 3 + j]);
+					CHECK(weight(j) == group.weights[vertex * 3 + j]);
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	logging::SetLevel(logging::ELevel::Warning);
+
+	fixtures::Parameters parameters;
+	parameters.groups = 3;
+	parameters.meshes = 3;
+	parameters.vertices = 61;
+	parameters.faces = 75;
+	parameters.bones = 12;
+	parameters.clips = 2;
+	parameters.keyframes = 25;
+	TestWriteGlb(parameters, "glb_skinned");
+
+	// no weights, second uv set, colors or animation samples
+	fixtures::Parameters plain = parameters;
+	plain.weight_bones = 0;
+	plain.uvs_2 = false;
+	plain.colors = false;
+	plain.keyframes = 0;
+	TestWriteGlb(plain, "glb_plain");
+
+	logging::Flush();
+	return check::Result();
+}
@@ -0,0 +1,208 @@
+#include <cmath>
+#include <array>
+#include <vector>
+#include <numbers>
+#include <cstdint>
+
+#include "check.h"
+#include "../kernels.h"
+
+// The batch kernels against plain per element code, with element counts that leave a scalar tail
+// after the SIMD blocks
+namespace
+{
+	void TestRebaseIndices()
+	{
+		std::vector<uint16_t> source(19);
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			source[i] = static_cast<uint16_t>(65535 - i * 1000);
+		}
+		std::vector<uint32_t> destination(source.size());
+		kernels::RebaseIndices(source, 70000, destination.data());
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			CHECK(destination[i] == 70000u + source[i]);
+		}
+	}
+
+	void TestExpandBoneWeights()
+	{
+		constexpr size_t vertex_count = 11;
+		std::vector<float> source(vertex_count * 2);
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			source[i] = static_cast<float>(i % 5) * 0.1f;
+		}
+		std::vector<float> destination(vertex_count * 3);
+		kernels::ExpandBoneWeights(source.data(), vertex_count, destination.data());
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			CHECK(destination[i * 3 + 0] == source[i * 2 + 0]);
+			CHECK(destination[i * 3 + 1] == source[i * 2 + 1]);
+			CHECK(destination[i * 3 + 2] == 1.f - source[i * 2 + 0] - source[i * 2 + 1]);
+		}
+	}
+
+	void TestResolveJoints()
+	{
+		std::vector<int> bones = { 7, 3, 11 };
+		std::vector<float> weights = { 0.5f, 0.5f, 0.f, 1.f, 0.f, 0.f };
+		std::vector<int8_t> bone_indices = { 2, 0, 1, 1, -100, 100 };
+		std::vector<uint16_t> joints(6, 42);
+		kernels::ResolveJoints(weights.data(), bone_indices.data(), bones, 2, joints.data());
+		CHECK(joints[0] == 11);
+		CHECK(joints[1] == 7);
+		CHECK(joints[3] == 3);
+		// zero weights never look their index up
+		CHECK(joints[2] == 42 && joints[4] == 42 && joints[5] == 42);
+	}
+
+	void TestMatrices()
+	{
+		// translations and 90 degree turns, count leaves a scalar tail after the 4 wide blocks
+		constexpr size_t count = 6;
+		std::array<std::vector<float>, 16> a;
+		std::array<std::vector<float>, 16> inverse;
+		std::array<std::vector<float>, 16> product;
+		for (int e = 0; e < 16; e++)
+		{
+			a[e].assign(count, 0.f);
+			inverse[e].assign(count, 0.f);
+			product[e].assign(count, 0.f);
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			// row-major, translation in the last row
+			a[0 * 4 + 1][i] = 1.f;
+			a[1 * 4 + 0][i] = -1.f;
+			a[2 * 4 + 2][i] = static_cast<float>(i + 1);
+			a[3 * 4 + 0][i] = static_cast<float>(i);
+			a[3 * 4 + 1][i] = 2.f;
+			a[3 * 4 + 3][i] = 1.f;
+		}
+
+		kernels::ConstMatrixStreams a_streams;
+		kernels::MatrixStreams inverse_streams;
+		kernels::ConstMatrixStreams const_inverse_streams;
+		kernels::MatrixStreams product_streams;
+		for (int e = 0; e < 16; e++)
+		{
+			a_streams[e] = a[e].data();
+			inverse_streams[e] = inverse[e].data();
+			const_inverse_streams[e] = inverse[e].data();
+			product_streams[e] = product[e].data();
+		}
+
+		kernels::InvertMatrices(a_streams, inverse_streams, count);
+		kernels::MultiplyMatrices(a_streams, const_inverse_streams, product_streams, count);
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					CHECK(check::Near(product[row * 4 + column][i], row == column ? 1.f : 0.f));
+				}
+			}
+		}
+
+		// singular matrices come out as zero
+		std::array<float, 16> zero{};
+		std::array<float, 16> singular_inverse;
+		singular_inverse.fill(1.f);
+		kernels::ConstMatrixStreams zero_streams;
+		kernels::MatrixStreams singular_streams;
+		for (int e = 0; e < 16; e++)
+		{
+			zero_streams[e] = &zero[e];
+			singular_streams[e] = &singular_inverse[e];
+		}
+		kernels::InvertMatrices(zero_streams, singular_streams, 1);
+		for (auto value : singular_inverse)
+		{
+			CHECK(value == 0.f);
+		}
+	}
+
+	void TestQuaternionsToEuler()
+	{
+		// single axis turns, then a mix; 7 rotations so both the SIMD block and the tail run
+		auto half = [](float degrees) { return degrees * std::numbers::pi_v<float> / 360.f; };
+		std::vector<float> quaternions = {
+			std::sin(half(30.f)), 0.f, 0.f, std::cos(half(30.f)),
+			0.f, std::sin(half(-45.f)), 0.f, std::cos(half(-45.f)),
+			0.f, 0.f, std::sin(half(120.f)), std::cos(half(120.f)),
+			0.f, 0.f, 0.f, 1.f,
+			std::sin(half(30.f)), 0.f, 0.f, std::cos(half(30.f)),
+			0.f, std::sin(half(-45.f)), 0.f, std::cos(half(-45.f)),
+			0.f, 0.f, std::sin(half(120.f)), std::cos(half(120.f)),
+		};
+		std::vector<float> expected = {
+			30.f, 0.f, 0.f,
+			0.f, -45.f, 0.f,
+			0.f, 0.f, 120.f,
+			0.f, 0.f, 0.f,
+			30.f, 0.f, 0.f,
+			0.f, -45.f, 0.f,
+			0.f, 0.f, 120.f,
+		};
+		std::vector<float> angles(expected.size());
+		kernels::QuaternionsToEuler(quaternions.data(), quaternions.size() / 4, angles.data());
+		for (size_t i = 0; i < angles.size(); i++)
+		{
+			CHECK(check::Near(angles[i], expected[i], 1e-3f));
+		}
+		// lanes and tail agree bit for bit
+		for (size_t i = 0; i < 9; i++)
+		{
+			CHECK(angles[i] == angles[12 + i]);
+		}
+	}
+
+	void TestAlignQuaternionHemispheres()
+	{
+		std::vector<float> quaternions = {
+			0.f, 0.f, 0.f, 1.f,
+			0.f, 0.f, 0.1f, -0.99f,
+			0.f, 0.f, -0.2f, 0.98f,
+		};
+		kernels::AlignQuaternionHemispheres(quaternions.data(), 3);
+		CHECK(quaternions[6] == -0.1f && quaternions[7] == 0.99f);
+		// follows the flipped predecessor, not the original one
+		CHECK(quaternions[10] == -0.2f && quaternions[11] == 0.98f);
+	}
+
+	void TestUnrollEulerAngles()
+	{
+		std::vector<float> angles = {
+			170.f, 0.f, -170.f,
+			-170.f, 10.f, 170.f,
+			-10.f, 0.f, 0.f,
+		};
+		kernels::UnrollEulerAngles(angles.data(), 3);
+		CHECK(angles[3] == 190.f && angles[4] == 10.f && angles[5] == -190.f);
+		// (350, 0, -360) is 340 degrees away, the equivalent (170, 180, -180) only 200
+		CHECK(angles[6] == 170.f && angles[7] == 180.f && angles[8] == -180.f);
+
+		// y passing 90 degrees: the decomposition jumps to the other triple, the filter turns it back
+		std::vector<float> gimbal = {
+			0.f, 80.f, 0.f,
+			180.f, 80.f, 180.f,
+		};
+		kernels::UnrollEulerAngles(gimbal.data(), 2);
+		CHECK(gimbal[3] == 0.f && gimbal[4] == 100.f && gimbal[5] == 0.f);
+	}
+}
+
+int main()
+{
+	TestRebaseIndices();
+	TestExpandBoneWeights();
+	TestResolveJoints();
+	TestMatrices();
+	TestQuaternionsToEuler();
+	TestAlignQuaternionHemispheres();
+	TestUnrollEulerAngles();
+	return check::Result();
+}
@@ -0,0 +1,613 @@
+#include <span>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "check.h"
+#include "../dxg.h"
+#include "../mrb.h"
+#include "../fixtures.h"
+#include "../kernels.h"
+#include "../log.h"
+#include "../mapped_file.h"
+#include "../scene_ir.h"
+#include "../skeleton.h"
+
+// Generated DXG/MRB files through ir::BuildMeshGroups/BuildAnimationClips, every value compared with
+// what the dxg.h/mrb.h overlays read from the same bytes
+namespace
+{
+	template<class T>
+	bool SameBytes(const T& a, const T& b)
+	{
+		return sizeof(a) == sizeof(b) && std::memcmp(&a, &b, sizeof(a)) == 0;
+	}
+
+	template<class T>
+	bool SameStream(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	// Generated vertices use one index for every stream. Shifting each stream by its own amount
+	// catches a stream gathered through another stream's index.
+	void ScrambleVertexIndices(std::vector<uint8_t>& file)
+	{
+		auto list_header = reinterpret_cast<const dxg::FileHeader*>(file.data())->GetMeshGroupListHeader();
+		for (uint32_t group_idx = 0; group_idx < list_header->group_count; group_idx++)
+		{
+			auto group_header = list_header->GetMeshGroupHeader(group_idx);
+			for (uint32_t group_data_idx = 0; group_data_idx < group_header->group_data_count; group_data_idx++)
+			{
+				auto data_header = group_header->GetMeshGroupDataHeader(group_data_idx);
+				auto shift = [](int16_t index, int amount, uint16_t count)
+				{
+					return static_cast<int16_t>(count ? (index + amount) % count : index);
+				};
+				for (int mesh_idx = 0; mesh_idx < data_header->mesh_count; mesh_idx++)
+				{
+					for (auto& vertex : data_header->GetMeshHeader(mesh_idx)->GetVertexDataIndices())
+					{
+						auto& indices = const_cast<dxg::VertexDataIndices&>(vertex);
+						indices.normal_index = shift(indices.position_index, 1, data_header->normal_count);
+						indices.uv_index = shift(indices.position_index, 2, data_header->uv_1_count);
+						indices.uv_2_index = shift(indices.position_index, 3, data_header->uv_2_count);
+						indices.color_index = shift(indices.position_index, 5, data_header->color_count);
+					}
+				}
+			}
+		}
+	}
+
+	// Same for the MRB pools: rotations are looked up one entry after the translations and every scale differs
+	void ScrambleKeyIndices(std::vector<uint8_t>& file)
+	{
+		auto file_header = reinterpret_cast<const mrb::FileHeader*>(file.data());
+		for (uint32_t animation_idx = 0; animation_idx < file_header->animation_count; animation_idx++)
+		{
+			auto animation_header = file_header->GetAnimationHeader(animation_idx);
+			auto rotation_count = animation_header->GetDataBlock<mrb::RotationsBlock>()->GetRotations().size();
+			for (auto& element : animation_header->GetDataBlock<mrb::IndexMapBlock>()->GetIndexes())
+			{
+				auto& indices = const_cast<mrb::IndexMapElement&>(element);
+				indices.rotation_index = static_cast<uint16_t>((indices.position_index + 1) % rotation_count);
+			}
+			auto scales = animation_header->GetDataBlock<mrb::ScalesBlock>()->GetScales();
+			for (size_t scale_idx = 0; scale_idx < scales.size(); scale_idx++)
+			{
+				auto value = 1.f + static_cast<float>(scale_idx) * 0.25f;
+				const_cast<Vector3&>(scales[scale_idx]) = { value, value * 2.f, value * 3.f };
+			}
+		}
+	}
+
+	void CheckSameMeshGroups(const std::vector<ir::MeshGroup>& a, const std::vector<ir::MeshGroup>& b)
+	{
+		CHECK(a.size() == b.size());
+		for (size_t group_idx = 0; group_idx < std::min(a.size(), b.size()); group_idx++)
+		{
+			auto& group_a = a[group_idx];
+			auto& group_b = b[group_idx];
+			CHECK(group_a.name == group_b.name);
+			CHECK(SameStream(group_a.positions, group_b.positions));
+			CHECK(SameStream(group_a.normals, group_b.normals));
+			CHECK(SameStream(group_a.uvs, group_b.uvs));
+			CHECK(SameStream(group_a.uvs_2, group_b.uvs_2));
+			CHECK(SameStream(group_a.colors, group_b.colors));
+			CHECK(group_a.indices == group_b.indices);
+			CHECK(group_a.joints == group_b.joints);
+			CHECK(group_a.weights == group_b.weights);
+			CHECK(group_a.skin_bones == group_b.skin_bones);
+		}
+	}
+
+	void CheckMeshGroups(const dxg::FileHeader* file_header, const Skeleton& skeleton, const fixtures::Parameters& parameters,
+		const std::vector<ir::MeshGroup>& groups)
+	{
+		auto list_header = file_header->GetMeshGroupListHeader();
+		CHECK(groups.size() == parameters.groups);
+		CHECK(groups.size() == list_header->group_count);
+		if (groups.size() != list_header->group_count)
+		{
+			return;
+		}
+
+		auto group_names = list_header->GetGroupNames()->Parse();
+		for (uint32_t group_idx = 0; group_idx < list_header->group_count; group_idx++)
+		{
+			auto& group = groups[group_idx];
+			auto group_header = list_header->GetMeshGroupHeader(group_idx);
+			CHECK(group.name == group_names[group_idx]);
+			CHECK(group.has_geometry);
+			CHECK(group.has_uvs_2 == parameters.uvs_2);
+			CHECK(group.has_colors == parameters.colors);
+
+			std::vector<int> skin_bones;
+			size_t vertex_base = 0;
+			size_t index_base = 0;
+			for (uint32_t group_data_idx = 0; group_data_idx < group_header->group_data_count; group_data_idx++)
+			{
+				auto data_header = group_header->GetMeshGroupDataHeader(group_data_idx);
+				auto view = data_header->GetView();
+				for (int mesh_idx = 0; mesh_idx < data_header->mesh_count; mesh_idx++)
+				{
+					auto mesh_header = data_header->GetMeshHeader(mesh_idx);
+					auto vertices = mesh_header->GetVertexDataIndices();
+					auto faces = mesh_header->GetFaces();
+					auto skinned = mesh_header->weight_bone_count && mesh_header->weight_bone_indices_count;
+
+					std::vector<int> weighted_bones;
+					if (mesh_header->weight_bone_count)
+					{
+						for (auto name : mesh_header->GetWeightedBoneNames()->Parse())
+						{
+							weighted_bones.push_back(skeleton.FindBone(name));
+							if (std::ranges::find(skin_bones, weighted_bones.back()) == skin_bones.end())
+							{
+								skin_bones.push_back(weighted_bones.back());
+							}
+						}
+					}
+					auto weight_bone_indices = mesh_header->GetWeightBoneIndices();
+
+					if (vertex_base + vertices.size() > group.GetVertexCount())
+					{
+						CHECK(vertex_base + vertices.size() <= group.GetVertexCount());
+						return;
+					}
+					for (size_t vertex_idx = 0; vertex_idx < vertices.size(); vertex_idx++)
+					{
+						auto& source = vertices[vertex_idx];
+						auto vertex = vertex_base + vertex_idx;
+						CHECK(SameBytes(group.positions[vertex], view.positions[source.position_index]));
+						CHECK(SameBytes(group.normals[vertex], view.normals[source.normal_index]));
+						CHECK(SameBytes(group.uvs[vertex], view.uvs[source.uv_index]));
+						if (data_header->uv_2_count)
+						{
+							CHECK(SameBytes(group.uvs_2[vertex], view.uvs_2[source.uv_2_index]));
+						}
+						if (data_header->color_count)
+						{
+							CHECK(SameBytes(group.colors[vertex], view.colors[source.color_index]));
+						}
+
+						auto weights = group.weights.data() + vertex * 3;
+						auto joints = group.joints.data() + vertex * 3;
+						if (!skinned)
+						{
+							CHECK(weights[0] == 0.f && weights[1] == 0.f && weights[2] == 0.f);
+							continue;
+						}
+
+						auto packed = view.weights[source.position_index];
+						CHECK(check::Near(weights[0], packed.data[0]));
+						CHECK(check::Near(weights[1], packed.data[1]));
+						CHECK(check::Near(weights[2], 1.f - packed.data[0] - packed.data[1]));
+						for (int influence = 0; influence < 3; influence++)
+						{
+							if (weights[influence] != 0.f)
+							{
+								CHECK(joints[influence] == weighted_bones[weight_bone_indices[vertex_idx].indices[influence]]);
+							}
+						}
+					}
+
+					for (size_t face_idx = 0; face_idx < faces.size(); face_idx++)
+					{
+						for (int corner = 0; corner < 3; corner++)
+						{
+							CHECK(group.indices[index_base + face_idx * 3 + corner] == vertex_base + faces[face_idx].indices[corner]);
+						}
+					}
+
+					vertex_base += vertices.size();
+					index_base += faces.size() * 3;
+				}
+			}
+
+			CHECK(vertex_base == group.GetVertexCount());
+			CHECK(index_base == group.indices.size());
+			CHECK(group.skin_bones == skin_bones);
+		}
+	}
+
+	// XYZ euler triples describing the same rotation, (x, y, z) and (x + 180, 180 - y, z + 180) plus whole turns
+	bool SameEulerRotation(const Vector3& a, const Vector3& b)
+	{
+		auto whole_turns = [](float degrees)
+		{
+			auto turns = degrees / 360.f;
+			return check::Near(turns, std::round(turns), 1e-4f);
+		};
+		return (whole_turns(a.x - b.x) && whole_turns(a.y - b.y) && whole_turns(a.z - b.z)) ||
+			(whole_turns(a.x - b.x - 180.f) && whole_turns(a.y - 180.f + b.y) && whole_turns(a.z - b.z - 180.f));
+	}
+
+	void CheckAnimationClip(const mrb::AnimationHeader* animation_header, const Skeleton& skeleton, const ir::AnimationClip& clip)
+	{
+		CHECK(clip.name == animation_header->name);
+
+		auto bone_names = animation_header->GetDataBlock<mrb::BoneNamesBlock>()->GetBoneNames();
+		auto keyframes = animation_header->GetDataBlock<mrb::KeyframesBlock>()->GetKeyframes();
+		auto positions = animation_header->GetDataBlock<mrb::PositionsBlock>()->GetPositions();
+		auto rotations = animation_header->GetDataBlock<mrb::RotationsBlock>()->GetRotations();
+		auto scales = animation_header->GetDataBlock<mrb::ScalesBlock>()->GetScales();
+		auto index_map = animation_header->GetDataBlock<mrb::IndexMapBlock>()->GetIndexes();
+
+		CHECK(std::ranges::equal(clip.key_times, keyframes));
+		CHECK(clip.tracks.size() == bone_names.size());
+		if (clip.tracks.size() != bone_names.size())
+		{
+			return;
+		}
+
+		for (size_t track_idx = 0; track_idx < clip.tracks.size(); track_idx++)
+		{
+			auto& track = clip.tracks[track_idx];
+			CHECK(track.bone == skeleton.FindBone(bone_names[track_idx]));
+			CHECK(track.translations.size() == keyframes.size());
+			CHECK(track.rotations.size() == keyframes.size());
+			CHECK(track.euler_rotations.size() == keyframes.size());
+			CHECK(track.scales.size() == keyframes.size());
+			CHECK(track.translation_keys.empty() && track.rotation_keys.empty() && track.scale_keys.empty());
+
+			for (size_t key = 0; key < keyframes.size(); key++)
+			{
+				auto indices = index_map[track_idx * keyframes.size() + key];
+				CHECK(SameBytes(track.translations[key], positions[indices.position_index]));
+				CHECK(SameBytes(track.scales[key], scales[indices.scale_index]));
+
+				// the stored quaternion or its negation, in the hemisphere of the previous key
+				auto& rotation = rotations[indices.rotation_index];
+				auto sign = track.rotations[key].w * rotation.w >= 0.f ? 1.f : -1.f;
+				for (int c = 0; c < 4; c++)
+				{
+					CHECK(track.rotations[key].raw[c] == sign * rotation.raw[c]);
+				}
+				if (key)
+				{
+					auto& previous = track.rotations[key - 1];
+					auto& current = track.rotations[key];
+					CHECK(previous.x * current.x + previous.y * current.y + previous.z * current.z + previous.w * current.w >= 0.f);
+				}
+
+				// the euler angles of the stored quaternion or their equivalent triple, up to whole turns
+				Vector3 euler;
+				kernels::QuaternionsToEuler(rotation.raw, 1, euler.raw);
+				CHECK(SameEulerRotation(track.euler_rotations[key], euler));
+				for (int c = 0; c < 3; c++)
+				{
+					if (key)
+					{
+						CHECK(std::abs(track.euler_rotations[key].raw[c] - track.euler_rotations[key - 1].raw[c]) <= 180.f);
+					}
+				}
+			}
+		}
+	}
+
+	void TestMeshGroups(const fixtures::Parameters& parameters, std::string_view name)
+	{
+		auto path = check::MakeTempFolder(name) / "fixture.dxg";
+		fixtures::WriteDxg(path, parameters);
+
+		auto file = check::ReadFile(path);
+		ScrambleVertexIndices(file);
+		auto file_header = reinterpret_cast<const dxg::FileHeader*>(file.data());
+		Skeleton skeleton(file_header->GetSkeletonHeader());
+
+		auto groups = ir::BuildMeshGroups(file_header, skeleton, 1);
+		CheckMeshGroups(file_header, skeleton, parameters, groups);
+		// the block jobs write disjoint slices, the thread count can't change the result
+		CheckSameMeshGroups(groups, ir::BuildMeshGroups(file_header, skeleton, 4));
+	}
+
+	void TestAnimationClips(const fixtures::Parameters& parameters, std::string_view name)
+	{
+		auto folder = check::MakeTempFolder(name);
+		fixtures::WriteDxg(folder / "fixture.dxg", parameters);
+		fixtures::WriteMrb(folder / "fixture.mrb", parameters);
+
+		MappedFile dxg_file(folder / "fixture.dxg");
+		Skeleton skeleton(reinterpret_cast<const dxg::FileHeader*>(dxg_file.data())->GetSkeletonHeader());
+
+		auto mrb_file = check::ReadFile(folder / "fixture.mrb");
+		ScrambleKeyIndices(mrb_file);
+		auto mrb_header = reinterpret_cast<const mrb::FileHeader*>(mrb_file.data());
+
+		logging::Buffer log;
+		std::vector<ir::AnimationClip> clips;
+		CHECK(ir::BuildAnimationClips(mrb_file, skeleton, {}, clips, log));
+		CHECK(clips.size() == parameters.clips);
+		for (uint32_t clip_idx = 0; clip_idx < std::min<size_t>(clips.size(), parameters.clips); clip_idx++)
+		{
+			CheckAnimationClip(mrb_header->GetAnimationHeader(clip_idx), skeleton, clips[clip_idx]);
+		}
+
+		// named clips only, unknown names are skipped
+		std::vector<std::string> clip_names = { "clip_1", "no_such_clip" };
+		std::vector<ir::AnimationClip> named_clips;
+		CHECK(ir::BuildAnimationClips(mrb_file, skeleton, clip_names, named_clips, log));
+		CHECK(named_clips.size() == 1);
+		if (named_clips.size() == 1)
+		{
+			CheckAnimationClip(mrb_header->GetAnimationHeader(1), skeleton, named_clips[0]);
+		}
+
+		// one name goes through the header walk instead of the directory
+		std::vector<std::string> single_name = { "clip_2" };
+		std::vector<ir::AnimationClip> single_clip;
+		CHECK(ir::BuildAnimationClips(mrb_file, skeleton, single_name, single_clip, log));
+		CHECK(single_clip.size() == 1);
+		if (single_clip.size() == 1)
+		{
+			CheckAnimationClip(mrb_header->GetAnimationHeader(2), skeleton, single_clip[0]);
+		}
+
+		// not an MRB file
+		std::vector<ir::AnimationClip> no_clips;
+		CHECK(!ir::BuildAnimationClips(dxg_file.GetData(), skeleton, {}, no_clips, log));
+		CHECK(no_clips.empty());
+		log.Flush();
+	}
+
+	// Value of a reduced channel at clip key key_idx, lerped between the kept keys around it like the FBX curves
+	template<class Vector>
+	Vector SampleChannel(const std::vector<uint32_t>& key_times, const std::vector<uint32_t>& keys, const std::vector<Vector>& values,
+		size_t key_idx)
+	{
+		if (keys.empty())
+		{
+			return values[key_idx];
+		}
+		auto next = static_cast<size_t>(std::ranges::upper_bound(keys, static_cast<uint32_t>(key_idx)) - keys.begin());
+		if (next == keys.size())
+		{
+			return values.back();
+		}
+		auto previous = next - 1;
+		auto t = static_cast<float>(key_times[key_idx] - key_times[keys[previous]]) /
+			static_cast<float>(key_times[keys[next]] - key_times[keys[previous]]);
+		Vector result;
+		for (size_t component = 0; component < std::size(result.raw); component++)
+		{
+			auto from = values[previous].raw[component];
+			result.raw[component] = from + (values[next].raw[component] - from) * t;
+		}
+		return result;
+	}
+
+	// Degrees between the rotation at clip key key_idx and the slerp of the kept quaternions around it, what glTF players show
+	double GetSlerpDeviation(const std::vector<uint32_t>& key_times, const std::vector<uint32_t>& keys, const std::vector<Vector4>& kept,
+		const Vector4& original, size_t key_idx)
+	{
+		using Rotation = std::array<double, 4>;
+		auto normalize = [](Rotation rotation)
+		{
+			auto length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+			for (auto& component : rotation)
+			{
+				component /= length;
+			}
+			return rotation;
+		};
+		auto to_rotation = [&](const Vector4& quaternion)
+		{
+			return normalize({ quaternion.x, quaternion.y, quaternion.z, quaternion.w });
+		};
+
+		Rotation sample;
+		auto next = keys.empty() ? 0 : static_cast<size_t>(std::ranges::upper_bound(keys, static_cast<uint32_t>(key_idx)) - keys.begin());
+		if (keys.empty() || next == keys.size())
+		{
+			sample = to_rotation(keys.empty() ? kept[key_idx] : kept.back());
+		}
+		else
+		{
+			auto from = to_rotation(kept[next - 1]);
+			auto to = to_rotation(kept[next]);
+			auto dot = from[0] * to[0] + from[1] * to[1] + from[2] * to[2] + from[3] * to[3];
+			if (dot < 0.0)
+			{
+				for (auto& component : to)
+				{
+					component = -component;
+				}
+				dot = -dot;
+			}
+			auto angle = std::acos(std::min(dot, 1.0));
+			auto t = static_cast<double>(key_times[key_idx] - key_times[keys[next - 1]]) / (key_times[keys[next]] - key_times[keys[next - 1]]);
+			for (int component = 0; component < 4; component++)
+			{
+				sample[component] = angle > 1e-9 ?
+					(from[component] * std::sin((1.0 - t) * angle) + to[component] * std::sin(t * angle)) / std::sin(angle) :
+					from[component] + (to[component] - from[component]) * t;
+			}
+			sample = normalize(sample);
+		}
+
+		auto target = to_rotation(original);
+		auto dot = std::abs(sample[0] * target[0] + sample[1] * target[1] + sample[2] * target[2] + sample[3] * target[3]);
+		return 2.0 * std::acos(std::min(dot, 1.0)) * 180.0 / std::numbers::pi;
+	}
+
+	Vector4 AxisAngle(float x, float y, float z, float degrees)
+	{
+		auto half = degrees * std::numbers::pi_v<float> / 360.f;
+		return { { { x * std::sin(half), y * std::sin(half), z * std::sin(half), std::cos(half) } } };
+	}
+
+	// 33 ms keys: a translation ramp with a bend, a rotation easing about z, and a constant scale
+	ir::AnimationClip MakeSmoothClip(size_t key_count)
+	{
+		ir::AnimationClip clip;
+		clip.name = "smooth";
+		auto& track = clip.tracks.emplace_back();
+		track.bone = 0;
+		for (size_t key_idx = 0; key_idx < key_count; key_idx++)
+		{
+			auto time = static_cast<float>(key_idx) / static_cast<float>(key_count - 1);
+			clip.key_times.push_back(static_cast<uint32_t>(key_idx * 33));
+			track.translations.push_back({ { { time < 0.5f ? time : 1.f - time, 2.f * time, std::sin(time * 3.f) } } });
+			auto degrees = 90.f * time * time;
+			track.rotations.push_back(AxisAngle(0.f, 0.f, 1.f, degrees));
+			track.euler_rotations.push_back({ { { 0.f, 0.f, degrees } } });
+			track.scales.push_back({ { { 1.f, 2.f, 1.f } } });
+		}
+		return clip;
+	}
+
+	template<class Vector>
+	bool SameVector(const Vector& a, const Vector& b)
+	{
+		return std::ranges::equal(a.raw, b.raw);
+	}
+
+	void TestLosslessKeyReduction()
+	{
+		// runs of repeated samples: the keys inside a run go, its first and last stay
+		std::vector<int> pattern = { 0, 0, 0, 1, 2, 2, 2, 2, 3, 3, 4, 4 };
+		ir::AnimationClip clip;
+		auto& track = clip.tracks.emplace_back();
+		track.bone = 0;
+		for (size_t key_idx = 0; key_idx < pattern.size(); key_idx++)
+		{
+			auto value = static_cast<float>(pattern[key_idx]);
+			clip.key_times.push_back(static_cast<uint32_t>(key_idx * 40 + (key_idx % 3) * 7));
+			track.translations.push_back({ { { value, -value, value * 0.5f } } });
+			track.rotations.push_back(AxisAngle(1.f, 0.f, 0.f, value * 10.f));
+			track.euler_rotations.push_back({ { { value * 10.f, 0.f, 0.f } } });
+			track.scales.push_back({ { { 1.f, 1.f, 1.f } } });
+		}
+		auto original = clip;
+
+		ir::KeyReductionSettings settings;
+		settings.mode = ir::EKeyReduction::Lossless;
+		ir::ReduceKeys(clip, settings);
+
+		CHECK(track.translation_keys.size() < pattern.size());
+		CHECK(track.rotation_keys.size() < pattern.size());
+		auto& source = original.tracks[0];
+		for (size_t key_idx = 0; key_idx < pattern.size(); key_idx++)
+		{
+			CHECK(SameVector(SampleChannel(clip.key_times, track.translation_keys, track.translations, key_idx), source.translations[key_idx]));
+			CHECK(SameVector(SampleChannel(clip.key_times, track.rotation_keys, track.rotations, key_idx), source.rotations[key_idx]));
+			CHECK(SameVector(SampleChannel(clip.key_times, track.rotation_keys, track.euler_rotations, key_idx), source.euler_rotations[key_idx]));
+			CHECK(SameVector(SampleChannel(clip.key_times, track.scale_keys, track.scales, key_idx), source.scales[key_idx]));
+		}
+
+		// a constant channel collapses to its first key
+		CHECK(track.scale_keys == std::vector<uint32_t>{ 0 });
+		CHECK(track.scales.size() == 1);
+	}
+
+	template<class Vector>
+	void CheckWithinTolerance(const ir::AnimationClip& clip, const std::vector<uint32_t>& keys, const std::vector<Vector>& kept,
+		const std::vector<Vector>& original, float tolerance)
+	{
+		for (size_t key_idx = 0; key_idx < original.size(); key_idx++)
+		{
+			auto value = SampleChannel(clip.key_times, keys, kept, key_idx);
+			for (size_t component = 0; component < std::size(value.raw); component++)
+			{
+				// float rounding of the lerp on either side
+				CHECK(std::abs(value.raw[component] - original[key_idx].raw[component]) <= tolerance * 1.001f + 1e-6f);
+			}
+		}
+	}
+
+	void CheckLossyKeyReduction(ir::AnimationClip clip, const ir::KeyReductionSettings& settings)
+	{
+		auto original = clip;
+		ir::ReduceKeys(clip, settings);
+
+		auto key_count = clip.key_times.size();
+		for (size_t track_idx = 0; track_idx < clip.tracks.size(); track_idx++)
+		{
+			auto& track = clip.tracks[track_idx];
+			auto& source = original.tracks[track_idx];
+			CheckWithinTolerance(clip, track.translation_keys, track.translations, source.translations, settings.translation_tolerance);
+			CheckWithinTolerance(clip, track.rotation_keys, track.euler_rotations, source.euler_rotations, settings.rotation_tolerance);
+			CheckWithinTolerance(clip, track.scale_keys, track.scales, source.scales, settings.scale_tolerance);
+			for (size_t key_idx = 0; key_idx < key_count; key_idx++)
+			{
+				auto deviation = GetSlerpDeviation(clip.key_times, track.rotation_keys, track.rotations, source.rotations[key_idx], key_idx);
+				CHECK(deviation <= settings.rotation_tolerance * 1.001 + 1e-4);
+			}
+		}
+	}
+
+	void TestLossyKeyReduction()
+	{
+		ir::KeyReductionSettings settings;
+		settings.mode = ir::EKeyReduction::Lossy;
+		settings.translation_tolerance = 0.01f;
+		settings.rotation_tolerance = 0.5f;
+		settings.scale_tolerance = 0.001f;
+
+		auto clip = MakeSmoothClip(200);
+		CheckLossyKeyReduction(clip, settings);
+
+		auto reduced = clip;
+		ir::ReduceKeys(reduced, settings);
+		auto& track = reduced.tracks[0];
+		// the piecewise linear parts need only a few keys, the eased rotation keeps more
+		CHECK(!track.translation_keys.empty() && track.translation_keys.size() < 40);
+		CHECK(!track.rotation_keys.empty() && track.rotation_keys.size() < 100);
+		CHECK(track.scale_keys == std::vector<uint32_t>{ 0 });
+		CHECK(track.scales.size() == 1);
+
+		// euler curves that don't move can't hide a quaternion that does, glTF plays the quaternions
+		auto mismatched = clip;
+		for (auto& euler : mismatched.tracks[0].euler_rotations)
+		{
+			euler = { { { 0.f, 0.f, 0.f } } };
+		}
+		CheckLossyKeyReduction(mismatched, settings);
+		auto mismatched_reduced = mismatched;
+		ir::ReduceKeys(mismatched_reduced, settings);
+		CHECK(mismatched_reduced.tracks[0].rotation_keys.size() > 1);
+	}
+}
+
+int main()
+{
+	logging::SetLevel(logging::ELevel::Warning);
+
+	fixtures::Parameters skinned;
+	skinned.groups = 3;
+	skinned.meshes = 3;
+	skinned.vertices = 50;
+	skinned.faces = 60;
+	skinned.bones = 12;
+	TestMeshGroups(skinned, "skinned");
+
+	fixtures::Parameters unskinned = skinned;
+	unskinned.weight_bones = 0;
+	unskinned.uvs_2 = false;
+	unskinned.colors = false;
+	unskinned.seed = 7;
+	TestMeshGroups(unskinned, "unskinned");
+
+	fixtures::Parameters animated;
+	animated.groups = 1;
+	animated.bones = 12;
+	animated.clips = 3;
+	animated.keyframes = 20;
+	TestAnimationClips(animated, "animated");
+
+	// clips without keys give tracks without samples
+	fixtures::Parameters no_keyframes = animated;
+	no_keyframes.keyframes = 0;
+	TestAnimationClips(no_keyframes, "no_keyframes");
+
+	TestLosslessKeyReduction();
+	TestLossyKeyReduction();
+
+	logging::Flush();
+	return check::Result();
+}
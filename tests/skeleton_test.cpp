@@ -0,0 +1,202 @@
+#include <span>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "check.h"
+#include "../dxg.h"
+#include "../fixtures.h"
+#include "../log.h"
+#include "../mapped_file.h"
+#include "../skeleton.h"
+
+// Topological ordering and bind pose of Skeleton, on a generated DXG and on hand written skeleton headers
+namespace
+{
+	template<class T>
+	void Append(std::vector<uint8_t>& buffer, const T& value)
+	{
+		auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	Matrix4x4 Translation(float x, float y, float z)
+	{
+		Matrix4x4 matrix;
+		matrix.m[0][0] = matrix.m[1][1] = matrix.m[2][2] = matrix.m[3][3] = 1.f;
+		matrix.m[3][0] = x;
+		matrix.m[3][1] = y;
+		matrix.m[3][2] = z;
+		return matrix;
+	}
+
+	struct SourceBone
+	{
+		std::string name;
+		int8_t parent;
+		// world position in the bind pose, the DXG matrix is its inverse translation
+		Vector3 position;
+	};
+
+	// SkeletonHeader, StringList with the names, links and world -> bone matrices, the layout dxg.h reads
+	std::vector<uint8_t> MakeSkeletonHeader(std::span<const SourceBone> bones)
+	{
+		std::string names;
+		for (auto& bone : bones)
+		{
+			names += bone.name;
+			names += '\0';
+		}
+		names += '\0';
+
+		std::vector<uint8_t> buffer;
+		Append(buffer, dxg::SkeletonHeader{ static_cast<uint32_t>(bones.size()), 0 });
+		Append(buffer, dxg::StringList{ static_cast<uint32_t>(names.size()) });
+		buffer.insert(buffer.end(), names.begin(), names.end());
+		for (size_t bone = 0; bone < bones.size(); bone++)
+		{
+			Append(buffer, dxg::BoneLink{ static_cast<int8_t>(bone), bones[bone].parent, -1, -1 });
+		}
+		for (auto& bone : bones)
+		{
+			Append(buffer, Translation(-bone.position.x, -bone.position.y, -bone.position.z));
+		}
+		return buffer;
+	}
+
+	const dxg::SkeletonHeader* GetHeader(const std::vector<uint8_t>& buffer)
+	{
+		return reinterpret_cast<const dxg::SkeletonHeader*>(buffer.data());
+	}
+
+	void CheckIdentityRotation(const Skeleton& skeleton, int bone)
+	{
+		CHECK(check::Near(skeleton.local_rotations[bone].x, 0.f));
+		CHECK(check::Near(skeleton.local_rotations[bone].y, 0.f));
+		CHECK(check::Near(skeleton.local_rotations[bone].z, 0.f));
+		CHECK(check::Near(skeleton.local_quaternions[bone].w, 1.f));
+		for (int c = 0; c < 3; c++)
+		{
+			CHECK(check::Near(skeleton.local_scales[bone].raw[c], 1.f));
+		}
+	}
+
+	// every bone is listed after its parent and the maps agree with each other
+	void CheckTopology(const Skeleton& skeleton)
+	{
+		for (int bone = 0; bone < static_cast<int>(skeleton.GetBoneCount()); bone++)
+		{
+			CHECK(skeleton.parents[bone] < bone);
+			CHECK(skeleton.GetBoneIndex(skeleton.source_indices[bone]) == bone);
+			CHECK(skeleton.FindBone(skeleton.names[bone]) == bone);
+		}
+	}
+
+	void TestFixtureSkeleton()
+	{
+		fixtures::Parameters parameters;
+		parameters.groups = 1;
+		parameters.bones = 15;
+		auto path = check::MakeTempFolder("skeleton") / "fixture.dxg";
+		fixtures::WriteDxg(path, parameters);
+
+		MappedFile file(path);
+		auto header = reinterpret_cast<const dxg::FileHeader*>(file.data())->GetSkeletonHeader();
+		Skeleton skeleton(header);
+		CHECK(skeleton.GetBoneCount() == parameters.bones);
+		CheckTopology(skeleton);
+		CHECK(skeleton.FindBone("no_such_bone") == -1);
+
+		auto links = header->GetBoneLinks();
+		auto matrices = header->GetBoneMatrices();
+		for (int bone = 0; bone < static_cast<int>(skeleton.GetBoneCount()); bone++)
+		{
+			auto source = skeleton.source_indices[bone];
+			auto parent = skeleton.parents[bone];
+			CHECK(parent == (links[source].parent >= 0 ? skeleton.GetBoneIndex(links[source].parent) : -1));
+			CHECK(std::memcmp(&skeleton.inverse_bind_matrices[bone], &matrices[source], sizeof(Matrix4x4)) == 0);
+
+			// bind matrices are pure translations, the global one undoes the DXG matrix
+			for (int c = 0; c < 3; c++)
+			{
+				auto world = skeleton.global_bind_matrices[bone].m[3][c];
+				CHECK(check::Near(world, -matrices[source].m[3][c]));
+				auto parent_world = parent >= 0 ? skeleton.global_bind_matrices[parent].m[3][c] : 0.f;
+				CHECK(check::Near(skeleton.local_translations[bone].raw[c], world - parent_world));
+			}
+			CheckIdentityRotation(skeleton, bone);
+		}
+	}
+
+	void TestReorderedSkeleton()
+	{
+		// children stored before their parents, one bone stuck in a parent cycle
+		std::vector<SourceBone> bones = {
+			{ "hand", 1, { 2.f, 3.f, 0.f } },
+			{ "arm", 3, { 1.f, 3.f, 0.f } },
+			{ "cycle", 4, { 9.f, 9.f, 9.f } },
+			{ "root", -1, { 0.f, 1.f, 0.f } },
+			{ "loop", 2, { 8.f, 8.f, 8.f } },
+		};
+		auto buffer = MakeSkeletonHeader(bones);
+		Skeleton skeleton(GetHeader(buffer));
+		CHECK(skeleton.GetBoneCount() == bones.size());
+		CheckTopology(skeleton);
+
+		auto root = skeleton.FindBone("root");
+		auto arm = skeleton.FindBone("arm");
+		auto hand = skeleton.FindBone("hand");
+		CHECK(root == 0);
+		CHECK(skeleton.parents[root] == -1);
+		CHECK(skeleton.parents[arm] == root);
+		CHECK(skeleton.parents[hand] == arm);
+		CHECK(skeleton.GetBoneIndex(3) == root);
+		CHECK(skeleton.source_indices[hand] == 0);
+
+		CHECK(check::Near(skeleton.local_translations[root].y, 1.f));
+		CHECK(check::Near(skeleton.local_translations[arm].x, 1.f));
+		CHECK(check::Near(skeleton.local_translations[arm].y, 2.f));
+		CHECK(check::Near(skeleton.local_translations[hand].x, 1.f));
+		CHECK(check::Near(skeleton.local_translations[hand].y, 0.f));
+		CHECK(check::Near(skeleton.global_bind_matrices[hand].m[3][0], 2.f));
+		CHECK(check::Near(skeleton.global_bind_matrices[hand].m[3][1], 3.f));
+	}
+
+	void TestRotatedBone()
+	{
+		// child turned 90 degrees about z relative to its parent: x axis -> y axis
+		std::vector<SourceBone> bones = {
+			{ "root", -1, { 0.f, 0.f, 0.f } },
+			{ "child", 0, { 0.f, 0.f, 0.f } },
+		};
+		auto buffer = MakeSkeletonHeader(bones);
+		auto matrices = const_cast<Matrix4x4*>(GetHeader(buffer)->GetBoneMatrices().data());
+		// world -> bone is the inverse rotation, rows are the rotated basis vectors
+		Matrix4x4 inverse_bind;
+		inverse_bind.m[0][1] = -1.f;
+		inverse_bind.m[1][0] = 1.f;
+		inverse_bind.m[2][2] = 1.f;
+		inverse_bind.m[3][3] = 1.f;
+		std::memcpy(&matrices[1], &inverse_bind, sizeof(Matrix4x4));
+
+		Skeleton skeleton(GetHeader(buffer));
+		auto child = skeleton.FindBone("child");
+		CHECK(check::Near(skeleton.local_rotations[child].x, 0.f, 1e-4f));
+		CHECK(check::Near(skeleton.local_rotations[child].y, 0.f, 1e-4f));
+		CHECK(check::Near(skeleton.local_rotations[child].z, 90.f, 1e-4f));
+		CHECK(check::Near(skeleton.local_quaternions[child].z, std::sqrt(0.5f)));
+		CHECK(check::Near(skeleton.local_quaternions[child].w, std::sqrt(0.5f)));
+	}
+}
+
+int main()
+{
+	logging::SetLevel(logging::ELevel::Warning);
+
+	TestFixtureSkeleton();
+	TestReorderedSkeleton();
+	TestRotatedBone();
+
+	logging::Flush();
+	return check::Result();
+}
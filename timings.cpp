@@ -0,0 +1,159 @@
+#include "timings.h"
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+#include "json.h"
+#include "log.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace
+{
+	struct Record
+	{
+		std::string name;
+		std::string file;
+		std::chrono::nanoseconds start;
+		std::chrono::nanoseconds wall;
+		std::chrono::nanoseconds cpu;
+		timings::Counts counts;
+		uint64_t allocations;
+		uint64_t allocated_bytes;
+		int64_t peak_bytes;
+	};
+
+	std::atomic<bool> enabled = false;
+	// start_ms of the records is relative to Enable
+	std::chrono::steady_clock::time_point origin;
+	std::mutex records_mutex;
+	std::vector<Record> records;
+
+	// user + kernel time of every thread of the process
+	std::chrono::nanoseconds GetProcessCpuTime()
+	{
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		{
+			return {};
+		}
+		auto ticks = [](FILETIME time)
+		{
+			return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+		};
+		// 100 ns ticks
+		return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+#else
+		timespec time;
+		if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+		{
+			return {};
+		}
+		return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+#endif
+	}
+
+	double ToMilliseconds(std::chrono::nanoseconds duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+}
+
+namespace timings
+{
+	void Enable()
+	{
+		origin = std::chrono::steady_clock::now();
+		enabled = true;
+	}
+
+	bool IsEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	Phase::Phase(std::string_view name, std::string_view file)
+		: _trace(name, file)
+		, _enabled(IsEnabled())
+	{
+		if (_enabled)
+		{
+			_name = name;
+			_file = file;
+			_cpu_start = GetProcessCpuTime();
+			_memory_start = memory::GetStats();
+			_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	Phase::~Phase()
+	{
+		if (!_enabled)
+		{
+			return;
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		auto cpu_end = GetProcessCpuTime();
+		auto memory_end = memory::GetStats();
+
+		std::lock_guard lock(records_mutex);
+		records.push_back({ std::move(_name), std::move(_file), _start - origin, end - _start, cpu_end - _cpu_start, counts,
+			memory_end.allocations - _memory_start.allocations, memory_end.allocated_bytes - _memory_start.allocated_bytes,
+			memory::IsEnabled() ? _peak_watch.GetPeak() : 0 });
+	}
+
+	void Write(const std::filesystem::path& path)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		if (!stream)
+		{
+			throw std::logic_error(std::format("Failed to open '{}'\n", path.string()));
+		}
+
+		std::lock_guard lock(records_mutex);
+		stream << "{\"phases\":[";
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			auto& record = records[i];
+			stream << std::format(
+				"{}\n{{\"name\":\"{}\",\"file\":\"{}\",\"start_ms\":{:.3f},\"wall_ms\":{:.3f},\"cpu_ms\":{:.3f},"
+				"\"bytes\":{},\"vertices\":{},\"faces\":{},\"keys\":{},\"clusters\":{},"
+				"\"allocations\":{},\"allocated_bytes\":{},\"peak_bytes\":{}}}",
+				i ? "," : "", EscapeJson(record.name), EscapeJson(record.file), ToMilliseconds(record.start),
+				ToMilliseconds(record.wall), ToMilliseconds(record.cpu), record.counts.bytes, record.counts.vertices,
+				record.counts.faces, record.counts.keys, record.counts.clusters, record.allocations, record.allocated_bytes,
+				record.peak_bytes);
+		}
+		stream << "\n]}\n";
+	}
+
+	void LogMemoryReport()
+	{
+		if (!logging::IsEnabled(logging::ELevel::Info))
+		{
+			return;
+		}
+
+		constexpr double MEGABYTE = 1024.0 * 1024.0;
+		std::lock_guard lock(records_mutex);
+		std::string report = "Memory per phase: allocations, allocated MB, peak MB\n";
+		for (auto&& record : records)
+		{
+			report += std::format("  {}{}: {}, {:.1f}, {:.1f}\n", record.name, record.file.empty() ? "" : std::format(" '{}'", record.file),
+				record.allocations, record.allocated_bytes / MEGABYTE, record.peak_bytes / MEGABYTE);
+		}
+		logging::Write(std::move(report));
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <string_view>
+#include <filesystem>
+
+#include "trace.h"
+#include "memory.h"
+
+// Per phase timing report written by --timings, one JSON record per phase and file.
+// Nothing is recorded until Enable, a Phase constructed before that costs a branch.
+namespace timings
+{
+	// Work done by a phase, whatever applies to it, 0 otherwise
+	struct Counts
+	{
+		uint64_t bytes = 0;
+		uint64_t vertices = 0;
+		uint64_t faces = 0;
+		uint64_t keys = 0;
+		uint64_t clusters = 0;
+	};
+
+	void Enable();
+	bool IsEnabled();
+
+	// Times the scope it lives in and records it on destruction. file is the input or output the phase works on.
+	// Phases nest, run on any thread and show up in the trace as well. CPU time is the whole process's,
+	// phases running at the same time (export jobs) each see the CPU time of the others.
+	// With memory tracking on, allocations and the peak of live bytes are process wide the same way.
+	class Phase
+	{
+	public:
+		explicit Phase(std::string_view name, std::string_view file = {});
+		~Phase();
+
+		Phase(const Phase&) = delete;
+		Phase& operator=(const Phase&) = delete;
+
+		Counts counts;
+
+	private:
+		trace::Scope _trace;
+		bool _enabled;
+		std::string _name;
+		std::string _file;
+		std::chrono::steady_clock::time_point _start;
+		std::chrono::nanoseconds _cpu_start{};
+		memory::Stats _memory_start;
+		memory::PeakWatch _peak_watch;
+	};
+
+	// Every phase recorded so far in completion order, throws std::logic_error if the file can't be written
+	void Write(const std::filesystem::path& path);
+
+	// Allocation count, allocated bytes and peak live bytes of every phase recorded so far, at info level
+	void LogMemoryReport();
+}
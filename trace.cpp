@@ -0,0 +1,120 @@
+#include "trace.h"
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+#include "json.h"
+
+namespace
+{
+	struct Event
+	{
+		std::string name;
+		std::string detail;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point end;
+	};
+
+	struct ThreadEvents
+	{
+		uint32_t id;
+		bool main;
+		std::vector<Event> events;
+	};
+
+	std::atomic<bool> enabled = false;
+	std::chrono::steady_clock::time_point origin;
+	std::thread::id main_thread;
+
+	// deque so the per thread buffers stay put, they outlive their threads until Write
+	std::mutex registry_mutex;
+	std::deque<ThreadEvents> registry;
+	thread_local ThreadEvents* thread_events = nullptr;
+
+	// the lock is only taken the first time a thread records something
+	ThreadEvents& GetThreadEvents()
+	{
+		if (!thread_events)
+		{
+			std::lock_guard lock(registry_mutex);
+			thread_events = &registry.emplace_back();
+			thread_events->id = static_cast<uint32_t>(registry.size());
+			thread_events->main = std::this_thread::get_id() == main_thread;
+		}
+		return *thread_events;
+	}
+
+	// trace timestamps are microseconds
+	double ToMicroseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+}
+
+namespace trace
+{
+	void Enable()
+	{
+		origin = std::chrono::steady_clock::now();
+		main_thread = std::this_thread::get_id();
+		enabled = true;
+	}
+
+	bool IsEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	Scope::Scope(std::string_view name, std::string_view detail)
+		: _enabled(IsEnabled())
+	{
+		if (_enabled)
+		{
+			_name = name;
+			_detail = detail;
+			_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	Scope::~Scope()
+	{
+		if (_enabled)
+		{
+			GetThreadEvents().events.push_back({ std::move(_name), std::move(_detail), _start, std::chrono::steady_clock::now() });
+		}
+	}
+
+	void Write(const std::filesystem::path& path)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		if (!stream)
+		{
+			throw std::logic_error(std::format("Failed to open '{}'\n", path.string()));
+		}
+
+		std::lock_guard lock(registry_mutex);
+		stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		auto separator = "";
+		for (auto&& thread : registry)
+		{
+			stream << std::format("{}\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+				separator, thread.id, thread.main ? std::string("main") : std::format("worker {}", thread.id));
+			separator = ",";
+
+			for (auto&& event : thread.events)
+			{
+				stream << std::format(
+					",\n{{\"name\":\"{}\",\"cat\":\"dxg\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"detail\":\"{}\"}}}}",
+					EscapeJson(event.name), thread.id, ToMicroseconds(event.start - origin), ToMicroseconds(event.end - event.start),
+					EscapeJson(event.detail));
+			}
+		}
+		stream << "\n]}\n";
+	}
+}
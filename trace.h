@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+// Chrome trace event output written by --trace, opens in chrome://tracing and ui.perfetto.dev.
+// Scopes become complete events on the thread they ran on, every thread buffers its own events.
+// Nothing is recorded until Enable, a Scope constructed before that costs a branch.
+namespace trace
+{
+	// Call from the main thread, it's named after it in the trace
+	void Enable();
+	bool IsEnabled();
+
+	// Records the scope it lives in as one event, detail (a file, group or clip name) goes into its args
+	class Scope
+	{
+	public:
+		explicit Scope(std::string_view name, std::string_view detail = {});
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		bool _enabled;
+		std::string _name;
+		std::string _detail;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	// Every event recorded so far, call once the threads are done. Throws std::logic_error if the file can't be written.
+	void Write(const std::filesystem::path& path);
+}